@@ -0,0 +1,632 @@
+// End to end benchmark of full queries against fixture projects of increasing size.
+// Every case runs the scraper as its own process a number of times, records its latency
+// percentiles, throughput and peak memory, and checks its text and json output against
+// golden files, so an optimization can't quietly change what's found.
+//
+// build: g++ -std=c++17 -O2 bench/e2e_bench.cpp -o e2e_bench -lpthread
+
+#include "../json.hpp"
+#include "../json_writer.hpp"
+#include "../logger.hpp"
+#include "../output_renderer.hpp"
+#include "../utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+using colors = logger::console_colors;
+
+// the scraper's exit code when something went wrong, rather than nothing being found
+static constexpr int scraper_exit_error = 2;
+
+// a single query against a single fixture project
+struct bench_case {
+    std::string name{};
+    std::filesystem::path project_path{};
+    std::vector<std::string> query{};
+};
+
+// how a single run of the scraper went
+struct child_result {
+    bool started = false;
+    int exit_code = 0;
+    uint64_t wall_ns = 0;
+    uint64_t peak_rss_bytes = 0;
+};
+
+// what a case measured over all of its runs
+struct case_result {
+    const bench_case *bench = nullptr;
+    bool failed = false;
+    std::vector<uint64_t> wall_ns{};
+    uint64_t peak_rss_bytes = 0;
+    uint64_t maps = 0;
+    uint64_t commands = 0;
+    // 'ok', 'updated' or what didn't match
+    std::string text_check{};
+    std::string json_check{};
+};
+
+// run program with args inside working_path, its console goes nowhere
+static child_result run_child(const std::filesystem::path &program, const std::vector<std::string> &args,
+                              const std::filesystem::path &working_path) {
+
+    child_result result{};
+
+#ifdef _WIN32
+    std::string command_line = "\"" + program.string() + "\"";
+    for (const auto &arg : args) {
+        command_line += " \"" + arg + "\"";
+    }
+
+    SECURITY_ATTRIBUTES attributes{sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE null_handle = CreateFileA("NUL", GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                     &attributes, OPEN_EXISTING, 0, nullptr);
+
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = null_handle;
+    startup.hStdOutput = null_handle;
+    startup.hStdError = null_handle;
+
+    PROCESS_INFORMATION process{};
+    const std::string working_directory = working_path.string();
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!CreateProcessA(nullptr, command_line.data(), nullptr, nullptr, TRUE, 0, nullptr,
+                        working_directory.data(), &startup, &process)) {
+        CloseHandle(null_handle);
+        return result;
+    }
+
+    WaitForSingleObject(process.hProcess, INFINITE);
+    result.wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    DWORD exit_code = 0;
+    GetExitCodeProcess(process.hProcess, &exit_code);
+
+    PROCESS_MEMORY_COUNTERS memory{};
+    if (GetProcessMemoryInfo(process.hProcess, &memory, sizeof(memory))) {
+        result.peak_rss_bytes = memory.PeakWorkingSetSize;
+    }
+
+    CloseHandle(process.hThread);
+    CloseHandle(process.hProcess);
+    CloseHandle(null_handle);
+
+    result.started = true;
+    result.exit_code = static_cast<int>(exit_code);
+#else
+    const std::string program_path = program.string();
+    const std::string working_directory = working_path.string();
+
+    std::vector<char *> argv{};
+    argv.push_back(const_cast<char *>(program_path.data()));
+    for (const auto &arg : args) {
+        argv.push_back(const_cast<char *>(arg.data()));
+    }
+    argv.push_back(nullptr);
+
+    const auto start = std::chrono::steady_clock::now();
+
+    const pid_t pid = fork();
+    if (pid < 0) {
+        return result;
+    }
+
+    if (pid == 0) {
+        const int null_fd = open("/dev/null", O_RDWR);
+        if (null_fd < 0 || chdir(working_directory.data()) != 0) {
+            _exit(127);
+        }
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+
+        execv(program_path.data(), argv.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    rusage usage{};
+    if (wait4(pid, &status, 0, &usage) != pid) {
+        return result;
+    }
+
+    result.wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+
+    // exec failing shows up as 127, that's not a run of the scraper
+    result.started = WIFEXITED(status) && WEXITSTATUS(status) != 127;
+    result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+#ifdef __APPLE__
+    result.peak_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    result.peak_rss_bytes = static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+
+    return result;
+}
+
+// the whole file, empty if it doesn't exist
+static std::string read_file(const std::filesystem::path &path) {
+
+    std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// compare output to the golden file, or replace the golden file with it
+// returns 'ok', 'updated' or where they first differ
+static std::string check_golden(const std::filesystem::path &output_path, const std::filesystem::path &golden_path, bool update) {
+
+    const std::string output = read_file(output_path);
+
+    if (update) {
+        std::ofstream golden(golden_path, std::ios_base::out | std::ios_base::binary);
+        if (!golden.is_open() || !(golden << output)) {
+            return utils::format(format_literal("unable to write '%s'"), golden_path.string());
+        }
+        return "updated";
+    }
+
+    if (!std::filesystem::exists(golden_path)) {
+        return utils::format(format_literal("missing '%s', run with --update-golden first"), golden_path.string());
+    }
+
+    const std::string golden = read_file(golden_path);
+    if (output == golden) {
+        return "ok";
+    }
+
+    // report the first line that differs
+    const auto [output_end, golden_end] = std::mismatch(output.begin(), output.end(), golden.begin(), golden.end());
+    const auto line = std::count(output.begin(), output_end, '\n') + 1;
+
+    return utils::format(format_literal("differs from '%s' at line %d"), golden_path.string(), line);
+}
+
+// one '<name> <project directory> <query..>' per line, '#' starts a comment
+static std::optional<std::vector<bench_case>> read_fixtures(const std::filesystem::path &path) {
+
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        log_err(R"(unable to open fixtures '%s')", path.string());
+        return std::nullopt;
+    }
+
+    std::vector<bench_case> cases{};
+
+    std::string line{};
+    for (uint32_t line_number = 1; std::getline(file, line); ++line_number) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::istringstream tokens(line);
+        std::vector<std::string> words{std::istream_iterator<std::string>(tokens), std::istream_iterator<std::string>()};
+        if (words.empty()) {
+            continue;
+        }
+        if (words.size() < 4) {
+            log_err(R"(fixtures line %d needs a name, a project directory and a query)", line_number);
+            return std::nullopt;
+        }
+
+        bench_case bench{};
+        bench.name = words[0];
+        bench.project_path = words[1];
+        bench.query.assign(words.begin() + 2, words.end());
+        cases.push_back(std::move(bench));
+    }
+
+    return cases;
+}
+
+// the nearest-rank percentile of sorted values
+static uint64_t percentile(const std::vector<uint64_t> &sorted, uint32_t percent) {
+
+    if (sorted.empty()) {
+        return 0;
+    }
+
+    const size_t rank = (sorted.size() * percent + 99) / 100;
+    return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+// nanoseconds as milliseconds with 3 decimals, e.g. 12.345
+static void append_ms(output_renderer &renderer, uint64_t ns) {
+    renderer.append(format_literal("%d.%03d"), ns / 1000000, (ns / 1000) % 1000);
+}
+
+// the options the harness was started with
+struct bench_options {
+    std::filesystem::path scraper_path{};
+    std::filesystem::path fixtures_path{};
+    std::filesystem::path golden_path = "bench/golden";
+    std::filesystem::path work_path = "e2e_out";
+    uint32_t runs = 5;
+    bool update_golden = false;
+    std::string json_path{};
+    std::string baseline_path{};
+};
+
+// the p50 of every case of an earlier --json run by name, to compare against
+using baseline_medians = std::map<std::string, uint64_t, std::less<>>;
+
+// read the medians of the cases that didn't fail out of an earlier --json run
+// returns nothing if it can't be read
+static std::optional<baseline_medians> read_baseline(const std::filesystem::path &path) {
+
+    try {
+        baseline_medians medians{};
+        for (const auto &result : json::parse(read_file(path))) {
+            if (!result["failed"].get<bool>()) {
+                medians[result["name"].get<std::string>()] = result["p50_ns"].get<uint64_t>();
+            }
+        }
+        return medians;
+    } catch (const std::exception &e) {
+        log_err(R"(unable to read the baseline '%s': %s)", path.string(), e.what());
+        return std::nullopt;
+    }
+}
+
+// how much after changed from before, e.g. -12.3%
+static void append_change(output_renderer &renderer, uint64_t before, uint64_t after) {
+
+    append_ms(renderer, before);
+    renderer.append_raw(" ms -> ");
+    append_ms(renderer, after);
+    renderer.append_raw(" ms  ");
+
+    if (before == 0) {
+        return;
+    }
+
+    // in tenths of a percent
+    const uint64_t change = (after > before ? after - before : before - after) * 1000 / before;
+    const auto color = after > before ? colors::RED : colors::GREEN;
+    renderer.append_colored(color, colors::BLACK, format_literal("%s%d.%d%%"), (after > before ? "+" : "-"), change / 10, change % 10);
+}
+
+// run a single case: one json run that's checked and warms the file cache, then the timed text runs
+static case_result run_case(const bench_options &options, const bench_case &bench) {
+
+    case_result result{};
+    result.bench = &bench;
+
+    if (!std::filesystem::is_directory(bench.project_path / "data")) {
+        log_err(R"(%s: '%s' doesn't have a data/ folder)", bench.name, bench.project_path.string());
+        result.failed = true;
+        return result;
+    }
+
+    const auto text_path = std::filesystem::absolute(options.work_path / (bench.name + ".txt"));
+    const auto json_path = std::filesystem::absolute(options.work_path / (bench.name + ".json"));
+    const auto stats_path = std::filesystem::absolute(options.work_path / (bench.name + ".stats.json"));
+
+    const auto run = [&](const std::filesystem::path &output_path, bool with_stats) {
+        // stale output of a previous run would hide one that wrote nothing
+        std::error_code error{};
+        std::filesystem::remove(output_path, error);
+
+        auto args = bench.query;
+        args.push_back(output_path.string());
+        if (with_stats) {
+            args.push_back("--stats-json");
+            args.push_back(stats_path.string());
+        }
+
+        const auto child = run_child(options.scraper_path, args, bench.project_path);
+        if (!child.started || child.exit_code >= scraper_exit_error) {
+            log_err(R"(%s: the scraper failed with exit code %d)", bench.name, child.exit_code);
+            result.failed = true;
+        }
+        return child;
+    };
+
+    run(json_path, false);
+    if (result.failed) {
+        return result;
+    }
+    result.json_check = check_golden(json_path, options.golden_path / (bench.name + ".json"), options.update_golden);
+
+    for (uint32_t i = 0; i < options.runs; ++i) {
+        const auto child = run(text_path, true);
+        if (result.failed) {
+            return result;
+        }
+
+        result.wall_ns.push_back(child.wall_ns);
+        result.peak_rss_bytes = std::max(result.peak_rss_bytes, child.peak_rss_bytes);
+
+        // every run does the same work, the first one is enough to check and count
+        if (i != 0) {
+            continue;
+        }
+
+        result.text_check = check_golden(text_path, options.golden_path / (bench.name + ".txt"), options.update_golden);
+
+        try {
+            const json stats = json::parse(read_file(stats_path));
+            result.maps = stats["phases"]["read_maps"]["calls"].get<uint64_t>();
+            // pages that can't hold a hit are skipped, their commands still count as covered
+            const auto &counters = stats["counters"];
+            result.commands = counters["commands_visited"].get<uint64_t>() + counters.value("commands_skipped", uint64_t{0});
+        } catch (const std::exception &e) {
+            log_warn(R"(%s: unable to read the scraper's stats: %s)", bench.name, e.what());
+        }
+    }
+
+    std::sort(result.wall_ns.begin(), result.wall_ns.end());
+
+    return result;
+}
+
+static bool is_check_ok(std::string_view check) {
+    return check == "ok" || check == "updated";
+}
+
+static void print_results(const std::vector<case_result> &results, const baseline_medians &baseline) {
+
+    output_renderer renderer(logger::get().colors_enabled(), 16 * 1024);
+
+    // the medians of the cases both runs have, summed up
+    uint64_t total_before = 0;
+    uint64_t total_after = 0;
+
+    for (const auto &result : results) {
+        const auto &bench = *result.bench;
+
+        renderer.append_raw("=========================================\n");
+        renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("%s"), bench.name);
+        renderer.append(format_literal(" (%s:"), bench.project_path.string());
+        for (const auto &word : bench.query) {
+            renderer.append(format_literal(" %s"), word);
+        }
+        renderer.append_raw(")\n");
+
+        if (result.failed) {
+            renderer.append_colored(colors::RED, colors::BLACK, format_literal("\tfailed\n"));
+            continue;
+        }
+
+        const uint64_t median_ns = percentile(result.wall_ns, 50);
+
+        renderer.append(format_literal("\tlatency ms   %d runs  p50 "), result.wall_ns.size());
+        append_ms(renderer, median_ns);
+        renderer.append_raw("  p90 ");
+        append_ms(renderer, percentile(result.wall_ns, 90));
+        renderer.append_raw("  p99 ");
+        append_ms(renderer, percentile(result.wall_ns, 99));
+        renderer.append_raw("  max ");
+        append_ms(renderer, result.wall_ns.back());
+        renderer.newline();
+
+        if (const auto before = baseline.find(bench.name); before != baseline.end()) {
+            renderer.append_raw("\tvs baseline  p50 ");
+            append_change(renderer, before->second, median_ns);
+            renderer.newline();
+
+            total_before += before->second;
+            total_after += median_ns;
+        }
+
+        if (median_ns != 0) {
+            renderer.append(format_literal("\tthroughput   %d maps/s  %d commands/s (at p50)\n"),
+                            result.maps * 1000000000ull / median_ns, result.commands * 1000000000ull / median_ns);
+        }
+
+        renderer.append(format_literal("\tpeak rss     %d.%d MB\n"), result.peak_rss_bytes / (1024 * 1024), result.peak_rss_bytes * 10 / (1024 * 1024) % 10);
+
+        for (const auto &[kind, check] : {std::pair{"text", &result.text_check}, std::pair{"json", &result.json_check}}) {
+            renderer.append(format_literal("\t%s output  "), kind);
+            if (is_check_ok(*check)) {
+                renderer.append_colored(colors::GREEN, colors::BLACK, format_literal("%s"), *check);
+            } else {
+                renderer.append_colored(colors::RED, colors::BLACK, format_literal("%s"), *check);
+            }
+            renderer.newline();
+        }
+    }
+
+    if (total_before != 0) {
+        renderer.append_raw("=========================================\n");
+        renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("vs baseline"));
+        renderer.append_raw(" (p50 summed over every case both runs have)\n\t");
+        append_change(renderer, total_before, total_after);
+        renderer.newline();
+    }
+
+    renderer.append_raw("=========================================\n");
+
+    renderer.write_to_console();
+}
+
+// every case as an object of a single json array
+static void write_results_json(std::ostream &os, const std::vector<case_result> &results) {
+
+    json_writer writer(os);
+    writer.begin_array();
+
+    for (const auto &result : results) {
+        writer.begin_object();
+        writer.field("commands", result.commands);
+        writer.field("failed", result.failed);
+        writer.field("json_check", result.json_check);
+        writer.field("maps", result.maps);
+        writer.field("name", result.bench->name);
+        writer.field("p50_ns", percentile(result.wall_ns, 50));
+        writer.field("p90_ns", percentile(result.wall_ns, 90));
+        writer.field("p99_ns", percentile(result.wall_ns, 99));
+        writer.field("peak_rss_bytes", result.peak_rss_bytes);
+        writer.field("runs", result.wall_ns.size());
+        writer.field("text_check", result.text_check);
+        writer.key("wall_ns");
+        writer.begin_array();
+        for (const auto wall_ns : result.wall_ns) {
+            writer.value(wall_ns);
+        }
+        writer.end_array();
+        writer.end_object();
+    }
+
+    writer.end_array();
+    writer.newline();
+}
+
+void print_usage() {
+    log_colored(colors::RED, colors::BLACK,
+                "incorrect usage - please use the harness like so:\n"
+                "e2e_bench <scraper executable> <fixtures file> [--runs 5] [--golden bench/golden] [--work e2e_out]\n"
+                "          [--update-golden] [--json results.json] [--baseline earlier_results.json]");
+}
+
+int main(int argc, const char *argv[]) {
+
+    bench_options options{};
+    std::vector<std::string_view> positional{};
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg{argv[i]};
+
+        if (arg == "--update-golden") {
+            options.update_golden = true;
+            continue;
+        }
+
+        if (arg == "--runs" || arg == "--golden" || arg == "--work" || arg == "--json" || arg == "--baseline") {
+            if (i + 1 >= argc) {
+                print_usage();
+                return 1;
+            }
+            const std::string_view value{argv[++i]};
+
+            if (arg == "--runs") {
+                const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.runs);
+                if (error != std::errc{} || end != value.data() + value.size() || options.runs == 0) {
+                    print_usage();
+                    return 1;
+                }
+            } else if (arg == "--golden") {
+                options.golden_path = std::string(value);
+            } else if (arg == "--work") {
+                options.work_path = std::string(value);
+            } else if (arg == "--baseline") {
+                options.baseline_path = std::string(value);
+            } else {
+                options.json_path = std::string(value);
+            }
+            continue;
+        }
+
+        positional.push_back(arg);
+    }
+
+    if (positional.size() != 2) {
+        print_usage();
+        return 1;
+    }
+
+    // the scraper runs inside each project directory, so it has to be found from anywhere
+    options.scraper_path = std::filesystem::absolute(std::string(positional[0]));
+    options.fixtures_path = std::string(positional[1]);
+
+    // json on stdout replaces the report, the progress goes to stderr so it can be piped straight into other tools
+    if (options.json_path == "-") {
+        logger::get().set_stream(std::cerr);
+    }
+
+    const auto cases = read_fixtures(options.fixtures_path);
+    if (!cases) {
+        logger::get().flush();
+        return 1;
+    }
+
+    baseline_medians baseline{};
+    if (!options.baseline_path.empty()) {
+        auto medians = read_baseline(options.baseline_path);
+        if (!medians) {
+            logger::get().flush();
+            return 1;
+        }
+        baseline = std::move(*medians);
+    }
+
+    std::error_code error{};
+    std::filesystem::create_directories(options.work_path, error);
+    if (!error && options.update_golden) {
+        std::filesystem::create_directories(options.golden_path, error);
+    }
+    if (error) {
+        log_err(R"(unable to create the output directories: %s)", error.message());
+        logger::get().flush();
+        return 1;
+    }
+
+    std::vector<case_result> results{};
+    bool all_ok = true;
+
+    for (const auto &bench : *cases) {
+        log_info(R"(running %s %d times...)", bench.name, options.runs);
+
+        results.push_back(run_case(options, bench));
+
+        const auto &result = results.back();
+        all_ok &= !result.failed && is_check_ok(result.text_check) && is_check_ok(result.json_check);
+    }
+
+    logger::get().flush();
+
+    if (options.json_path == "-") {
+        write_results_json(std::cout, results);
+        return all_ok ? 0 : 1;
+    }
+
+    print_results(results, baseline);
+
+    if (!options.json_path.empty()) {
+        std::ofstream file(options.json_path, std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open() || !file.good()) {
+            log_err(R"(unable to create '%s')", options.json_path);
+            all_ok = false;
+        } else {
+            write_results_json(file, results);
+        }
+    }
+
+    logger::get().flush();
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,467 @@
+// Microbenchmarks of the loader's and matchers' hot paths over synthetic inputs.
+// Every case reports the time, allocations and allocated bytes per operation,
+// the allocations are counted by the global operator new in memory_usage.cpp.
+//
+// build: g++ -std=c++17 -O2 bench/microbench.cpp $(ls *.cpp | grep -v main.cpp) -o microbench -lpthread
+
+#include "../json_writer.hpp"
+#include "../logger.hpp"
+#include "../memory_usage.hpp"
+#include "../output_renderer.hpp"
+#include "../rpgmaker_project.hpp"
+#include "../rpgmaker_scraper.hpp"
+#include "../rpgmaker_types.hpp"
+#include "../utils.hpp"
+
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using colors = logger::console_colors;
+
+// results are folded in here so the compiler can't drop the work producing them
+static volatile uint64_t benchmark_sink = 0;
+
+// an ostream buffer that only counts what's written to it
+class null_buffer : public std::streambuf {
+protected:
+    int_type overflow(int_type ch) override {
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char *, std::streamsize count) override {
+        return count;
+    }
+};
+
+// runs every case until it took long enough to be measured and keeps what it measured
+class benchmark_runner {
+public:
+    benchmark_runner(std::string_view _filter, uint64_t _min_time_ms) : filter(_filter), min_time_ns(_min_time_ms * 1000000) {}
+
+    struct result {
+        std::string name{};
+        uint64_t iterations = 0;
+        uint64_t total_ns = 0;
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    // measure op, which returns anything convertible to uint64_t
+    template<typename op_t>
+    void run(std::string_view name, op_t &&op) {
+
+        if (!filter.empty() && name.find(filter) == std::string_view::npos) {
+            return;
+        }
+
+        // warm up caches and lazily built statics before measuring
+        benchmark_sink = benchmark_sink ^ static_cast<uint64_t>(op());
+
+        uint64_t iterations = 1;
+        for (;;) {
+            const uint64_t allocations_before = memory_usage::thread_allocations();
+            const uint64_t bytes_before = memory_usage::thread_allocated_bytes();
+            const auto start = std::chrono::steady_clock::now();
+
+            for (uint64_t i = 0; i < iterations; ++i) {
+                benchmark_sink = benchmark_sink ^ static_cast<uint64_t>(op());
+            }
+
+            const auto elapsed = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count());
+
+            if (elapsed >= min_time_ns || iterations >= max_iterations) {
+                results.push_back({std::string(name), iterations, elapsed,
+                                   memory_usage::thread_allocations() - allocations_before,
+                                   memory_usage::thread_allocated_bytes() - bytes_before});
+                return;
+            }
+
+            // aim a bit past the minimum time, but never grow more than 100x on a single guess
+            const uint64_t scale = elapsed ? (min_time_ns + min_time_ns / 5) / elapsed + 1 : 100;
+            iterations *= std::clamp<uint64_t>(scale, 2, 100);
+        }
+    }
+
+    // print every result as a table to the console
+    void print() const {
+
+        output_renderer renderer(logger::get().colors_enabled(), 16 * 1024);
+
+        renderer.append_raw("=========================================\n");
+        renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("benchmark"));
+        renderer.append_raw("                                                ns/op   allocs/op    bytes/op   iterations\n");
+        renderer.append_raw("=========================================\n");
+
+        for (const auto &[name, iterations, total_ns, allocations, bytes] : results) {
+            renderer.append(format_literal("%s"), name);
+            for (size_t pad = name.size(); pad < 50; ++pad) {
+                renderer.append_raw(" ");
+            }
+
+            // two decimals for everything, a lot of these take less than a nanosecond or allocation per op
+            append_per_op(renderer, total_ns, iterations, 12);
+            append_per_op(renderer, allocations, iterations, 12);
+            append_per_op(renderer, bytes, iterations, 12);
+            renderer.append(format_literal(" %12d\n"), iterations);
+        }
+
+        renderer.append_raw("=========================================\n");
+
+        renderer.write_to_console();
+    }
+
+    // write every result as a single json object keyed by name, the values are per op
+    void write_json(std::ostream &os) const {
+
+        json_writer writer(os);
+        writer.begin_object();
+
+        for (const auto &[name, iterations, total_ns, allocations, bytes] : results) {
+            writer.key(name);
+            writer.begin_object();
+            // hundredths, json_writer only writes integers
+            writer.field("allocs_per_op_x100", allocations * 100 / iterations);
+            writer.field("bytes_per_op_x100", bytes * 100 / iterations);
+            writer.field("iterations", iterations);
+            writer.field("ns_per_op_x100", total_ns * 100 / iterations);
+            writer.end_object();
+        }
+
+        writer.end_object();
+        writer.newline();
+    }
+
+    bool empty() const {
+        return results.empty();
+    }
+
+private:
+    static constexpr uint64_t max_iterations = 1ull << 32;
+
+    // total / iterations with 2 decimals, right aligned to width
+    static void append_per_op(output_renderer &renderer, uint64_t total, uint64_t iterations, size_t width) {
+
+        const uint64_t hundredths = total * 100 / iterations;
+
+        utils::small_string<32> text{};
+        utils::format_to(text, format_literal("%d.%02d"), hundredths / 100, hundredths % 100);
+
+        for (size_t pad = text.view().size(); pad < width; ++pad) {
+            renderer.append_raw(" ");
+        }
+        renderer.append(format_literal("%s"), text.view());
+    }
+
+    std::string_view filter{};
+    uint64_t min_time_ns = 0;
+
+    std::vector<result> results{};
+};
+
+// The benchmark cases, a friend of the project and scraper to reach the steps they're made of
+class ScrapeBenchmarks {
+public:
+    static void run(benchmark_runner &runner) {
+
+        constexpr uint32_t query_id = 5;
+
+        // a project that never touches the disk, only the names the queries and output need
+        std::unique_ptr<RPGMakerProject> project(new RPGMakerProject(RPGMakerProject::deferred_maps_t{}, {}));
+        for (uint32_t id = 0; id <= 200; ++id) {
+            project->variable_names[id] = utils::format(format_literal("Variable %04d"), id);
+            project->switch_names[id] = utils::format(format_literal("Switch %04d"), id);
+            project->common_event_names[id] = utils::format(format_literal("Common Event %03d"), id);
+            project->map_info_names[id] = utils::format(format_literal("MAP%03d"), id);
+        }
+
+        const RPGMakerScraper variable_scraper(*project, ScrapeMode::VARIABLES, query_id);
+        const RPGMakerScraper switch_scraper(*project, ScrapeMode::SWITCHES, query_id);
+
+        // loading
+
+        const json if_statement_json = command_json(111, json::array({1, query_id, 0, 10, 1}));
+        const json control_variable_json = command_json(122, json::array({query_id, query_id, 0, 0, 42}));
+        const json script_json = command_json(355, json::array({"$gameVariables.setValue(5, $gameVariables.value(6) + 1);"}));
+        const json text_json = command_json(401, json::array({"A line of dialogue that's about as long as they get."}));
+
+        runner.run("Command::Command/if_statement", [&] { return Command(if_statement_json).parameters.size(); });
+        runner.run("Command::Command/control_variable", [&] { return Command(control_variable_json).parameters.size(); });
+        runner.run("Command::Command/script", [&] { return Command(script_json).parameters.size(); });
+        runner.run("Command::Command/text", [&] { return Command(text_json).parameters.size(); });
+
+        const json event = event_json(3, 20);
+
+        runner.run("Event::Event", [&] { return Event(event).page_count; });
+
+        MapEvents map_events{};
+        const json events = json::array({nullptr, event});
+        map_events.layout(events, {1});
+        runner.run("MapEvents::build_event/3_pages_20_commands", [&] {
+            map_events.build_event(0, event);
+            return map_events.pages.size();
+        });
+
+        const json common_event = common_event_json(20);
+        runner.run("CommonEvent::CommonEvent/20_commands", [&] { return CommonEvent(common_event).list.size(); });
+
+        // matching
+
+        const Command if_statement_hit(if_statement_json);
+        const Command if_statement_miss(command_json(111, json::array({1, query_id + 1, 0, 10, 1})));
+        const Command if_statement_switch(command_json(111, json::array({0, query_id, 0})));
+
+        runner.run("scrape_command_if_statement/hit", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_if_statement, if_statement_hit);
+        });
+        runner.run("scrape_command_if_statement/miss", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_if_statement, if_statement_miss);
+        });
+        runner.run("scrape_command_if_statement/switch_hit", [&] {
+            return scrape_with(switch_scraper, &RPGMakerScraper::scrape_command_if_statement, if_statement_switch);
+        });
+
+        const Command control_variable_hit(control_variable_json);
+        const Command control_variable_range(command_json(122, json::array({1, 10, 0, 2, 1, 100})));
+        const Command control_variable_miss(command_json(122, json::array({query_id + 1, query_id + 1, 0, 1, query_id + 2})));
+
+        runner.run("scrape_command_control_variable/hit", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_control_variable, control_variable_hit);
+        });
+        runner.run("scrape_command_control_variable/range_hit", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_control_variable, control_variable_range);
+        });
+        runner.run("scrape_command_control_variable/miss", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_control_variable, control_variable_miss);
+        });
+
+        const Command control_switch_hit(command_json(121, json::array({query_id, query_id, 0})));
+        const Command control_switch_miss(command_json(121, json::array({query_id + 1, query_id + 3, 1})));
+
+        runner.run("scrape_command_control_switch/hit", [&] {
+            return scrape_with(switch_scraper, &RPGMakerScraper::scrape_command_control_switch, control_switch_hit);
+        });
+        runner.run("scrape_command_control_switch/miss", [&] {
+            return scrape_with(switch_scraper, &RPGMakerScraper::scrape_command_control_switch, control_switch_miss);
+        });
+
+        const Command script_hit(script_json);
+        const Command script_miss(command_json(355, json::array({"this._generatedCounter = (this._generatedCounter || 0) + 1;"})));
+
+        runner.run("scrape_command_script/hit", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_script, script_hit);
+        });
+        runner.run("scrape_command_script/miss", [&] {
+            return scrape_with(variable_scraper, &RPGMakerScraper::scrape_command_script, script_miss);
+        });
+
+        // a page's worth of the usual command mix, most of which isn't a hit
+        const std::vector<Command> page = CommonEvent(common_event).list;
+        runner.run("scrape_command/20_command_page", [&] {
+            uint32_t hits = 0;
+            for (const auto &command : page) {
+                hits += scrape_with(variable_scraper, &RPGMakerScraper::scrape_command, command);
+            }
+            return hits;
+        });
+
+        const std::string read_line = "$gameVariables.value(5) >= 10";
+        const std::string write_line = "$gameVariables.setValue(5, 1);";
+        const std::string miss_line = "$gameVariables.setValue(6, $gameVariables.value(7) + $gameParty.size());";
+
+        runner.run("determine_access_from_script/read", [&] { return determine_access(variable_scraper, read_line); });
+        runner.run("determine_access_from_script/write", [&] { return determine_access(variable_scraper, write_line); });
+        runner.run("determine_access_from_script/miss", [&] { return determine_access(variable_scraper, miss_line); });
+
+        // output
+
+        const EventDetails details(event);
+        const ScrapeResults results = synthetic_results(*project, variable_scraper, details, 20, 50);
+
+        null_buffer discard{};
+        std::ostream discard_stream(&discard);
+
+        runner.run("ScrapeResults::write_json/1000_hits", [&] { return results.write_json(discard_stream); });
+        runner.run("ScrapeResults::operator<</1000_hits", [&] {
+            discard_stream << results;
+            return discard_stream.good();
+        });
+    }
+
+private:
+
+    static json command_json(uint32_t code, json parameters) {
+        return json{{"code", code}, {"indent", 0}, {"parameters", std::move(parameters)}};
+    }
+
+    // the usual mix of dialogue, branches, variable and switch changes and script
+    static json command_list_json(uint32_t command_count) {
+
+        const json mix[] = {
+            command_json(101, json::array({"Actor1", 0, 0, 2})),
+            command_json(401, json::array({"A line of dialogue that's about as long as they get."})),
+            command_json(111, json::array({1, 5, 0, 10, 1})),
+            command_json(401, json::array({"Another line of dialogue."})),
+            command_json(122, json::array({7, 7, 1, 0, 1})),
+            command_json(121, json::array({3, 3, 0})),
+            command_json(355, json::array({"$gameVariables.setValue(5, $gameVariables.value(6) + 1);"})),
+            command_json(655, json::array({"this._generatedCounter = 1;"})),
+            command_json(230, json::array({60})),
+            command_json(0, json::array()),
+        };
+
+        json list = json::array();
+        for (uint32_t i = 0; i < command_count; ++i) {
+            list.push_back(mix[i % std::size(mix)]);
+        }
+        list.push_back(command_json(0, json::array()));
+
+        return list;
+    }
+
+    static json event_json(uint32_t page_count, uint32_t command_count) {
+
+        json conditions = {
+            {"actorId", 1}, {"actorValid", false}, {"itemId", 1}, {"itemValid", false},
+            {"selfSwitchCh", "A"}, {"selfSwitchValid", false},
+            {"switch1Id", 1}, {"switch1Valid", false}, {"switch2Id", 1}, {"switch2Valid", false},
+            {"variableId", 5}, {"variableValid", true}, {"variableValue", 3},
+        };
+
+        json pages = json::array();
+        for (uint32_t i = 0; i < page_count; ++i) {
+            pages.push_back({{"conditions", conditions}, {"list", command_list_json(command_count)}, {"trigger", 0}});
+        }
+
+        return json{{"id", 1}, {"name", "EV001"}, {"note", ""}, {"pages", std::move(pages)}, {"x", 4}, {"y", 7}};
+    }
+
+    static json common_event_json(uint32_t command_count) {
+        return json{{"id", 1}, {"list", command_list_json(command_count)}, {"name", "Common Event 001"}, {"switchId", 1}, {"trigger", 0}};
+    }
+
+    // run a single matcher on a fresh result, the way scrape_map_events does
+    template<typename scrape_fn>
+    static bool scrape_with(const RPGMakerScraper &scraper, scrape_fn scrape, const Command &command) {
+        MapEventResult result_info{};
+        return (scraper.*scrape)(result_info, command);
+    }
+
+    static bool determine_access(const RPGMakerScraper &scraper, std::string_view script_line) {
+        MapEventResult result_info{};
+        return scraper.determine_access_from_script(result_info, script_line);
+    }
+
+    // map_count maps with hits_per_map hits each, cycling through every kind of action
+    static ScrapeResults synthetic_results(const RPGMakerProject &project, const RPGMakerScraper &scraper,
+                                           const EventDetails &details, uint32_t map_count, uint32_t hits_per_map) {
+
+        ScrapeResults results(project, ScrapeMode::VARIABLES, scraper.query_id, scraper.query_name);
+
+        const HitAction actions[] = {
+            {ActionType::EVENT_PAGE_CONDITION, 1, 1, 0, 0, 3, 0, {}},
+            {ActionType::IF_STATEMENT, 5, 5, 1, 0, 10, 0, {}},
+            {ActionType::CONTROL_VARIABLE, 5, 5, 0, 0, 42, 0, {}},
+            {ActionType::CONTROL_VARIABLE, 1, 10, 2, 2, 1, 100, {}},
+            {ActionType::SCRIPT, 0, 0, 0, 0, 0, 0, "$gameVariables.setValue(5, $gameVariables.value(6) + 1);"},
+        };
+
+        for (uint32_t map_id = 1; map_id <= map_count; ++map_id) {
+            auto &hits = results.results[map_id];
+
+            for (uint32_t i = 0; i < hits_per_map; ++i) {
+                MapEventResult hit{};
+                hit.access_type = i % 2 ? AccessType::READ : AccessType::WRITE;
+                hit.active = true;
+                hit.action = actions[i % std::size(actions)];
+                if (hit.action.type != ActionType::EVENT_PAGE_CONDITION) {
+                    hit.line_number = i + 1;
+                }
+                hit.event_info.id = i + 1;
+                hit.event_info.x = i % 17;
+                hit.event_info.y = i % 13;
+                hit.event_details = &details;
+                hit.event_page = 1;
+                hits.push_back(std::move(hit));
+            }
+        }
+
+        return results;
+    }
+};
+
+void print_usage() {
+    log_colored(colors::RED, colors::BLACK,
+                "incorrect usage - please use the benchmarks like so:\n"
+                "microbench [--filter scrape_command] [--min-time 200] [--json results.json]");
+}
+
+int main(int argc, const char *argv[]) {
+
+    std::string_view filter{};
+    uint64_t min_time_ms = 200;
+    std::string_view json_path{};
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg{argv[i]};
+
+        if (i + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+        const std::string_view value{argv[++i]};
+
+        if (arg == "--filter") {
+            filter = value;
+        } else if (arg == "--json") {
+            json_path = value;
+        } else if (arg == "--min-time" &&
+                   std::from_chars(value.data(), value.data() + value.size(), min_time_ms).ptr == value.data() + value.size()) {
+            continue;
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    // the scraper announces what it's verifying, that's only noise here
+    logger::get().set_level(log_level::LOG_WARN);
+
+    benchmark_runner runner(filter, min_time_ms);
+    ScrapeBenchmarks::run(runner);
+
+    if (runner.empty()) {
+        log_err(R"(no benchmark matches '%s')", filter);
+        logger::get().flush();
+        return 1;
+    }
+
+    // json on stdout replaces the table, so it can be piped straight into other tools
+    if (json_path == "-") {
+        logger::get().flush();
+        runner.write_json(std::cout);
+        return 0;
+    }
+
+    runner.print();
+
+    if (!json_path.empty()) {
+        std::ofstream file(std::string(json_path), std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open() || !file.good()) {
+            log_err(R"(unable to create '%s')", json_path);
+            logger::get().flush();
+            return 1;
+        }
+        runner.write_json(file);
+    }
+
+    logger::get().flush();
+    return 0;
+}
@@ -0,0 +1,118 @@
+#!/usr/bin/env bash
+# Builds the scraper with profile guided and link time optimization, then reports how much it gained.
+#   1. a plain -O2 build, measured with bench/e2e_bench as the baseline
+#   2. an instrumented build, run over the training queries to collect a profile
+#   3. a build optimized with that profile and LTO, measured against the baseline
+# The optimized build's output is checked against the baseline's, so the profile can't change what's found.
+#
+# usage: bench/pgo_build.sh [training fixtures] [benchmark fixtures]
+#   run from the root of the repository, the defaults are bench/pgo_training.txt and bench/fixtures.txt
+#   CXX picks the compiler (g++ or clang++), OUT where everything goes (pgo_out), RUNS the timed runs per case (5)
+#   the fixture projects are written with bench/project_generator whenever they don't exist yet
+#
+# the optimized scraper ends up in $OUT/RPGMakerScraper
+
+set -euo pipefail
+
+training_fixtures=${1:-bench/pgo_training.txt}
+bench_fixtures=${2:-bench/fixtures.txt}
+
+CXX=${CXX:-g++}
+OUT=${OUT:-pgo_out}
+RUNS=${RUNS:-5}
+
+common_flags=(-std=c++17 -O2)
+link_flags=(-lpthread)
+
+if "$CXX" --version | grep -q clang; then
+    compiler=clang
+    generate_flags=(-fprofile-instr-generate)
+    use_flags=(-fprofile-instr-use="$OUT/profile/merged.profdata" -Wno-profile-instr-unprofiled -flto)
+else
+    compiler=gcc
+    # the scraper counts from several threads at once, non atomic counters would lose updates
+    generate_flags=(-fprofile-generate="$PWD/$OUT/profile" -fprofile-update=atomic)
+    use_flags=(-fprofile-use="$PWD/$OUT/profile" -fprofile-correction -Wno-missing-profile -flto=auto)
+fi
+
+log() {
+    echo "[ ~ ] $*"
+}
+
+# build every source but the ones in bench/ into $1 with the extra flags after it
+# the objects keep the same paths between builds, which is how gcc finds their profiles again
+build() {
+    local output=$1
+    shift
+
+    local objects=()
+    local pids=()
+    mkdir -p "$OUT/obj"
+
+    for source in *.cpp; do
+        local object="$OUT/obj/${source%.cpp}.o"
+        "$CXX" "${common_flags[@]}" "$@" -c "$source" -o "$object" &
+        pids+=($!)
+        objects+=("$object")
+    done
+
+    for pid in "${pids[@]}"; do
+        wait "$pid"
+    done
+
+    "$CXX" "${common_flags[@]}" "$@" "${objects[@]}" -o "$output" "${link_flags[@]}"
+}
+
+# write every project a fixtures file lists in its 'project_generator' comments that doesn't exist yet
+generate_projects() {
+    grep -E '^#[[:space:]]+project_generator' "$1" | sed -E 's/^#[[:space:]]+project_generator//' | while read -r args; do
+        local project
+        project=$(echo "$args" | sed -E 's/.*--out[[:space:]]+([^[:space:]]+).*/\1/')
+        if [ ! -d "$project/data" ]; then
+            log "generating $project..."
+            # shellcheck disable=SC2086
+            "$OUT/project_generator" $args
+        fi
+    done
+}
+
+if [ ! -f main.cpp ] || [ ! -f "$training_fixtures" ] || [ ! -f "$bench_fixtures" ]; then
+    echo "[ - ] run this from the root of the repository with existing fixture files" >&2
+    exit 2
+fi
+
+rm -rf "$OUT/obj" "$OUT/profile"
+mkdir -p "$OUT/profile"
+
+log "building the benchmark tools with $compiler..."
+"$CXX" "${common_flags[@]}" bench/project_generator.cpp -o "$OUT/project_generator" "${link_flags[@]}"
+"$CXX" "${common_flags[@]}" bench/e2e_bench.cpp -o "$OUT/e2e_bench" "${link_flags[@]}"
+
+generate_projects "$training_fixtures"
+generate_projects "$bench_fixtures"
+
+log "building and measuring the baseline..."
+build "$OUT/RPGMakerScraper-baseline"
+"$OUT/e2e_bench" "$OUT/RPGMakerScraper-baseline" "$bench_fixtures" --runs "$RUNS" --update-golden \
+    --golden "$OUT/golden" --work "$OUT/e2e_out" --json "$OUT/baseline.json"
+
+log "building the instrumented scraper..."
+rm -rf "$OUT/obj"
+build "$OUT/RPGMakerScraper-instrumented" "${generate_flags[@]}"
+
+log "training..."
+# clang writes a raw profile per process where this points, gcc ignores it
+LLVM_PROFILE_FILE="$PWD/$OUT/profile/%p.profraw" "$OUT/e2e_bench" "$OUT/RPGMakerScraper-instrumented" "$training_fixtures" \
+    --runs 1 --update-golden --golden "$OUT/training_golden" --work "$OUT/training_out" > /dev/null
+
+if [ "$compiler" = clang ]; then
+    "${LLVM_PROFDATA:-llvm-profdata}" merge -o "$OUT/profile/merged.profdata" "$OUT"/profile/*.profraw
+fi
+
+log "building the profile guided scraper..."
+rm -rf "$OUT/obj"
+build "$OUT/RPGMakerScraper" "${use_flags[@]}"
+
+log "measuring it against the baseline..."
+"$OUT/e2e_bench" "$OUT/RPGMakerScraper" "$bench_fixtures" --runs "$RUNS" --golden "$OUT/golden" \
+    --work "$OUT/e2e_out" --json "$OUT/pgo.json" --baseline "$OUT/baseline.json"
@@ -0,0 +1,566 @@
+// Writes a deterministic, synthetic RPG Maker MV project for benchmarking the scraper.
+// The same options and seed always produce byte for byte the same data/ tree,
+// on every platform and standard library.
+//
+// build: g++ -std=c++17 -O2 bench/project_generator.cpp -o project_generator -lpthread
+
+#include "../json_writer.hpp"
+#include "../logger.hpp"
+#include "../utils.hpp"
+
+#include <charconv>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using colors = logger::console_colors;
+
+// how much of what gets generated
+struct generator_options {
+    std::filesystem::path output_path = "generated_project";
+    uint32_t map_count = 100;
+    uint32_t map_width = 17;
+    uint32_t map_height = 13;
+    uint32_t events_per_map = 20;
+    uint32_t max_pages_per_event = 3;
+    uint32_t commands_per_page = 20;
+    uint32_t variable_count = 200;
+    uint32_t switch_count = 200;
+    uint32_t common_event_count = 50;
+    // percentage of script lines that touch a variable or switch
+    uint32_t script_density = 50;
+    uint64_t seed = 1;
+
+    // relative weights of the command codes that fill event pages
+    std::vector<std::pair<uint32_t, uint32_t>> command_mix = {
+        {101, 8},
+        {401, 20},
+        {111, 12},
+        {121, 10},
+        {122, 15},
+        {355, 8},
+        {655, 4},
+        {230, 5},
+        {0, 18},
+    };
+};
+
+// splitmix64, unlike the standard distributions it produces the same numbers everywhere
+class generator_random {
+public:
+    explicit generator_random(uint64_t seed) : state(seed) {}
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // a number in [min, max]
+    uint32_t range(uint32_t min, uint32_t max) {
+        return min + static_cast<uint32_t>(next() % (static_cast<uint64_t>(max) - min + 1));
+    }
+
+    // true percent out of 100 times
+    bool chance(uint32_t percent) {
+        return next() % 100 < percent;
+    }
+
+private:
+    uint64_t state = 0;
+};
+
+class project_generator {
+public:
+    explicit project_generator(const generator_options &_options) : options(_options), random(_options.seed) {
+        for (const auto &[code, weight] : options.command_mix) {
+            total_weight += weight;
+        }
+    }
+
+    // writes the whole data/ folder, returns false if a file couldn't be created
+    bool generate() {
+
+        const auto data_path = options.output_path / "data";
+
+        std::error_code error{};
+        std::filesystem::create_directories(data_path, error);
+        if (error) {
+            log_err(R"(unable to create '%s': %s)", data_path.string().data(), error.message().data());
+            return false;
+        }
+
+        if (!write_file(data_path / "System.json", [&](json_writer &writer) { write_system(writer); })) {
+            return false;
+        }
+        if (!write_file(data_path / "MapInfos.json", [&](json_writer &writer) { write_map_infos(writer); })) {
+            return false;
+        }
+        if (!write_file(data_path / "CommonEvents.json", [&](json_writer &writer) { write_common_events(writer); })) {
+            return false;
+        }
+
+        for (uint32_t map_id = 1; map_id <= options.map_count; ++map_id) {
+            const auto map_path = data_path / utils::format(format_literal("Map%03d.json"), map_id);
+            if (!write_file(map_path, [&](json_writer &writer) { write_map(writer, map_id); })) {
+                return false;
+            }
+        }
+
+        log_ok(R"(wrote %d maps, %d events, %d pages and %d commands (%d bytes) to '%s')",
+               options.map_count, event_count, page_count, command_count, byte_count, data_path.string().data());
+
+        return true;
+    }
+
+private:
+
+    template<typename write_fn>
+    bool write_file(const std::filesystem::path &path, write_fn &&write) {
+
+        std::ofstream file(path, std::ios_base::out | std::ios_base::binary);
+        if (!file.is_open() || !file.good()) {
+            log_err(R"(unable to create '%s')", path.string().data());
+            return false;
+        }
+
+        {
+            json_writer writer(file);
+            write(writer);
+        }
+
+        byte_count += static_cast<uint64_t>(file.tellp());
+        return true;
+    }
+
+    void write_system(json_writer &writer) {
+
+        writer.begin_object();
+
+        writer.key("gameTitle");
+        writer.value("Generated Project");
+
+        // id 0 is always an empty name, every 10th one is left unnamed like in real projects
+        const auto write_names = [&](std::string_view key, std::string_view prefix, uint32_t count) {
+            writer.key(key);
+            writer.begin_array();
+            writer.value("");
+            for (uint32_t id = 1; id <= count; ++id) {
+                writer.value(id % 10 ? utils::format(format_literal("%s %04d"), prefix, id) : std::string{});
+            }
+            writer.end_array();
+        };
+
+        write_names("switches", "Switch", options.switch_count);
+        write_names("variables", "Variable", options.variable_count);
+
+        writer.end_object();
+    }
+
+    void write_map_infos(json_writer &writer) {
+
+        writer.begin_array();
+        writer.null();
+
+        for (uint32_t map_id = 1; map_id <= options.map_count; ++map_id) {
+            writer.begin_object();
+            writer.field("expanded", false);
+            writer.field("id", map_id);
+            writer.field("name", utils::format(format_literal("MAP%03d"), map_id));
+            writer.field("order", map_id);
+            // every few maps are nested below the one before them
+            writer.field("parentId", map_id > 1 && map_id % 4 == 0 ? map_id - 1 : 0);
+            writer.field("scrollX", 0);
+            writer.field("scrollY", 0);
+            writer.end_object();
+        }
+
+        writer.end_array();
+    }
+
+    void write_common_events(json_writer &writer) {
+
+        writer.begin_array();
+        writer.null();
+
+        for (uint32_t id = 1; id <= options.common_event_count; ++id) {
+            writer.begin_object();
+            writer.field("id", id);
+            writer.key("list");
+            write_command_list(writer);
+            writer.field("name", utils::format(format_literal("Common Event %03d"), id));
+            writer.field("switchId", random_switch());
+            // mostly 'none', some autorun and parallel ones
+            writer.field("trigger", random.chance(80) ? 0 : random.range(1, 2));
+            writer.end_object();
+        }
+
+        writer.end_array();
+    }
+
+    void write_map(json_writer &writer, uint32_t map_id) {
+
+        writer.begin_object();
+        writer.field("autoplayBgm", false);
+        writer.field("displayName", utils::format(format_literal("Map %d"), map_id));
+        writer.field("height", options.map_height);
+        writer.field("note", "");
+        writer.field("tilesetId", 1);
+        writer.field("width", options.map_width);
+
+        // the tile layers make up most of a real map file, six per tile
+        writer.key("data");
+        writer.begin_array();
+        for (uint64_t tile = 0, tiles = static_cast<uint64_t>(options.map_width) * options.map_height * 6; tile < tiles; ++tile) {
+            writer.value(random.chance(60) ? 0 : random.range(1536, 8191));
+        }
+        writer.end_array();
+
+        writer.key("events");
+        writer.begin_array();
+        writer.null();
+
+        for (uint32_t id = 1; id <= options.events_per_map; ++id) {
+            // deleted events leave a null behind
+            if (random.chance(5)) {
+                writer.null();
+                continue;
+            }
+
+            writer.begin_object();
+            writer.field("id", id);
+            writer.field("name", utils::format(format_literal("EV%03d"), id));
+            writer.field("note", random.chance(10) ? "<generated note>" : "");
+
+            writer.key("pages");
+            writer.begin_array();
+            for (uint32_t page = 0, pages = random.range(1, std::max(options.max_pages_per_event, 1u)); page < pages; ++page) {
+                write_page(writer);
+            }
+            writer.end_array();
+
+            writer.field("x", random.range(0, options.map_width - 1));
+            writer.field("y", random.range(0, options.map_height - 1));
+            writer.end_object();
+
+            ++event_count;
+        }
+
+        writer.end_array();
+        writer.end_object();
+    }
+
+    void write_page(json_writer &writer) {
+
+        writer.begin_object();
+
+        writer.key("conditions");
+        writer.begin_object();
+        writer.field("actorId", 1);
+        writer.field("actorValid", false);
+        writer.field("itemId", 1);
+        writer.field("itemValid", false);
+        writer.field("selfSwitchCh", "A");
+        writer.field("selfSwitchValid", false);
+        writer.field("switch1Id", random_switch());
+        writer.field("switch1Valid", random.chance(25));
+        writer.field("switch2Id", random_switch());
+        writer.field("switch2Valid", random.chance(10));
+        writer.field("variableId", random_variable());
+        writer.field("variableValid", random.chance(20));
+        writer.field("variableValue", random.range(0, 10));
+        writer.end_object();
+
+        writer.field("directionFix", false);
+        writer.key("list");
+        write_command_list(writer);
+        writer.field("priorityType", 1);
+        writer.field("trigger", random.range(0, 4));
+
+        writer.end_object();
+
+        ++page_count;
+    }
+
+    // a page's or common event's commands, always ending on the code 0 RPG Maker terminates lists with
+    void write_command_list(json_writer &writer) {
+
+        writer.begin_array();
+
+        for (uint32_t i = 0; i < options.commands_per_page; ++i) {
+            write_command(writer, random_code());
+        }
+        write_command(writer, 0);
+
+        writer.end_array();
+    }
+
+    void write_command(json_writer &writer, uint32_t code) {
+
+        writer.begin_object();
+        writer.field("code", code);
+        writer.field("indent", 0);
+        writer.key("parameters");
+        writer.begin_array();
+
+        switch (code) {
+            // show text
+            case 101:
+                writer.value("Actor1");
+                writer.value(random.range(0, 7));
+                writer.value(0);
+                writer.value(2);
+                break;
+            // text line
+            case 401:
+                writer.value(utils::format(format_literal("Generated line of dialogue number %d."), random.range(1, 100000)));
+                break;
+            // conditional branch on a switch, a variable or a script
+            case 111: {
+                const uint32_t kind = random.range(0, 2);
+                if (kind == 0) {
+                    writer.value(0);
+                    writer.value(random_switch());
+                    writer.value(random.range(0, 1));
+                } else if (kind == 1) {
+                    writer.value(1);
+                    writer.value(random_variable());
+                    const uint32_t compare_type = random.range(0, 1);
+                    writer.value(compare_type);
+                    writer.value(compare_type ? random_variable() : random.range(0, 100));
+                    writer.value(random.range(0, 5));
+                } else {
+                    writer.value(12);
+                    writer.value(random_script());
+                }
+                break;
+            }
+            // control switches
+            case 121: {
+                const uint32_t first = random_switch();
+                writer.value(first);
+                writer.value(random.chance(80) ? first : std::min(first + random.range(1, 5), options.switch_count));
+                writer.value(random.range(0, 1));
+                break;
+            }
+            // control variables with every kind of operand
+            case 122: {
+                const uint32_t first = random_variable();
+                writer.value(first);
+                writer.value(random.chance(80) ? first : std::min(first + random.range(1, 5), options.variable_count));
+                writer.value(random.range(0, 5));
+
+                const uint32_t operand = random.range(0, 4);
+                writer.value(operand);
+                if (operand == 0) {
+                    writer.value(random.range(0, 9999));
+                } else if (operand == 1) {
+                    writer.value(random_variable());
+                } else if (operand == 2) {
+                    const uint32_t min = random.range(0, 50);
+                    writer.value(min);
+                    writer.value(min + random.range(1, 50));
+                } else if (operand == 3) {
+                    writer.value(random.range(0, 7));
+                    writer.value(random.range(1, 10));
+                    writer.value(0);
+                } else {
+                    writer.value(random_script());
+                }
+                break;
+            }
+            // script and its continued lines
+            case 355:
+            case 655:
+                writer.value(random_script());
+                break;
+            // wait
+            case 230:
+                writer.value(random.range(1, 120));
+                break;
+            default:
+                break;
+        }
+
+        writer.end_array();
+        writer.end_object();
+
+        ++command_count;
+    }
+
+    uint32_t random_code() {
+
+        if (total_weight == 0) {
+            return 0;
+        }
+
+        uint32_t pick = random.range(0, total_weight - 1);
+        for (const auto &[code, weight] : options.command_mix) {
+            if (pick < weight) {
+                return code;
+            }
+            pick -= weight;
+        }
+
+        return 0;
+    }
+
+    uint32_t random_variable() {
+        return random.range(1, std::max(options.variable_count, 1u));
+    }
+
+    uint32_t random_switch() {
+        return random.range(1, std::max(options.switch_count, 1u));
+    }
+
+    // a line of script, touching a variable or switch script_density percent of the time
+    std::string random_script() {
+
+        if (!random.chance(options.script_density)) {
+            return utils::format(format_literal("this._generatedCounter = (this._generatedCounter || 0) + %d;"), random.range(1, 9));
+        }
+
+        switch (random.range(0, 3)) {
+            case 0:
+                return utils::format(format_literal("$gameVariables.setValue(%d, $gameVariables.value(%d) + 1);"), random_variable(), random_variable());
+            case 1:
+                return utils::format(format_literal("$gameVariables.value(%d) >= %d"), random_variable(), random.range(0, 100));
+            case 2:
+                return utils::format(format_literal("$gameSwitches.setValue(%d, true);"), random_switch());
+            default:
+                return utils::format(format_literal("$gameSwitches.value(%d) && $gameParty.size() > 0"), random_switch());
+        }
+    }
+
+    const generator_options &options;
+
+    generator_random random;
+
+    uint32_t total_weight = 0;
+
+    uint64_t event_count = 0;
+    uint64_t page_count = 0;
+    uint64_t command_count = 0;
+    uint64_t byte_count = 0;
+};
+
+void print_usage() {
+    log_colored(colors::RED, colors::BLACK,
+                "incorrect usage - please use the generator like so:\n"
+                "project_generator [--out generated_project] [--maps 100] [--width 17] [--height 13]\n"
+                "                  [--events 20] [--pages 3] [--commands 20] [--variables 200] [--switches 200]\n"
+                "                  [--common-events 50] [--script-density 50] [--seed 1]\n"
+                "                  [--mix 101:8,401:20,111:12,121:10,122:15,355:8,655:4,230:5,0:18]");
+}
+
+// parse 'code:weight,code:weight,..'
+std::optional<std::vector<std::pair<uint32_t, uint32_t>>> parse_mix(std::string_view mix) {
+
+    std::vector<std::pair<uint32_t, uint32_t>> weights{};
+
+    while (!mix.empty()) {
+        const size_t comma = mix.find(',');
+        const std::string_view entry = mix.substr(0, comma);
+        mix = comma == std::string_view::npos ? std::string_view{} : mix.substr(comma + 1);
+
+        const size_t colon = entry.find(':');
+        if (colon == std::string_view::npos) {
+            return std::nullopt;
+        }
+
+        uint32_t code = 0;
+        uint32_t weight = 0;
+        const auto code_end = entry.data() + colon;
+        const auto weight_end = entry.data() + entry.size();
+
+        if (std::from_chars(entry.data(), code_end, code).ptr != code_end ||
+            std::from_chars(code_end + 1, weight_end, weight).ptr != weight_end) {
+            return std::nullopt;
+        }
+
+        weights.emplace_back(code, weight);
+    }
+
+    return weights;
+}
+
+int main(int argc, const char *argv[]) {
+
+    generator_options options{};
+
+    // every numeric option and where it goes
+    const std::pair<std::string_view, uint32_t *> numeric_options[] = {
+        {"--maps", &options.map_count},
+        {"--width", &options.map_width},
+        {"--height", &options.map_height},
+        {"--events", &options.events_per_map},
+        {"--pages", &options.max_pages_per_event},
+        {"--commands", &options.commands_per_page},
+        {"--variables", &options.variable_count},
+        {"--switches", &options.switch_count},
+        {"--common-events", &options.common_event_count},
+        {"--script-density", &options.script_density},
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg{argv[i]};
+
+        if (i + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+        const std::string_view value{argv[++i]};
+
+        if (arg == "--out") {
+            options.output_path = std::filesystem::path(std::string(value));
+            continue;
+        }
+
+        if (arg == "--mix") {
+            auto mix = parse_mix(value);
+            if (!mix) {
+                print_usage();
+                return 1;
+            }
+            options.command_mix = std::move(*mix);
+            continue;
+        }
+
+        if (arg == "--seed") {
+            if (std::from_chars(value.data(), value.data() + value.size(), options.seed).ptr != value.data() + value.size()) {
+                print_usage();
+                return 1;
+            }
+            continue;
+        }
+
+        bool parsed = false;
+        for (const auto &[name, target] : numeric_options) {
+            if (arg == name) {
+                parsed = std::from_chars(value.data(), value.data() + value.size(), *target).ptr == value.data() + value.size();
+                break;
+            }
+        }
+
+        if (!parsed) {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (options.map_width == 0 || options.map_height == 0 || options.script_density > 100) {
+        print_usage();
+        return 1;
+    }
+
+    project_generator generator(options);
+    const bool generated = generator.generate();
+
+    logger::get().flush();
+    return generated ? 0 : 1;
+}
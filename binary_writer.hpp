@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+enum class binary_format : uint32_t {
+    CBOR,
+    MSGPACK,
+};
+
+// Writes CBOR or MessagePack straight to a stream as values are handed to it.
+// Mirrors json_writer, except both formats need to know up front how many
+// members an object or array is going to have.
+class binary_writer {
+public:
+    binary_writer(std::ostream &_os, binary_format _format) : os(_os), format(_format) {
+        buffer.reserve(flush_threshold + 1024);
+    }
+
+    ~binary_writer() {
+        flush();
+    }
+
+    binary_writer(const binary_writer &) = delete;
+    binary_writer &operator=(const binary_writer &) = delete;
+
+    void begin_object(size_t count) {
+        if (format == binary_format::CBOR) {
+            write_cbor_header(5, count);
+        } else {
+            write_msgpack_header(0x80, 0xde, 0xdf, count);
+        }
+    }
+
+    void end_object() {
+        flush_if_full();
+    }
+
+    void begin_array(size_t count) {
+        if (format == binary_format::CBOR) {
+            write_cbor_header(4, count);
+        } else {
+            write_msgpack_header(0x90, 0xdc, 0xdd, count);
+        }
+    }
+
+    void end_array() {
+        flush_if_full();
+    }
+
+    void key(std::string_view name) {
+        value(name);
+    }
+
+    void value(std::string_view text) {
+        if (format == binary_format::CBOR) {
+            write_cbor_header(3, text.size());
+        } else if (text.size() < 32) {
+            put(static_cast<uint8_t>(0xa0 | text.size()));
+        } else if (text.size() <= UINT8_MAX) {
+            put(0xd9);
+            put_big_endian<uint8_t>(text.size());
+        } else if (text.size() <= UINT16_MAX) {
+            put(0xda);
+            put_big_endian<uint16_t>(text.size());
+        } else {
+            put(0xdb);
+            put_big_endian<uint32_t>(text.size());
+        }
+
+        buffer.append(text);
+        flush_if_full();
+    }
+
+    void value(const char *text) {
+        value(std::string_view(text));
+    }
+
+    void value(bool boolean) {
+        if (format == binary_format::CBOR) {
+            put(boolean ? 0xf5 : 0xf4);
+        } else {
+            put(boolean ? 0xc3 : 0xc2);
+        }
+    }
+
+    template<typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    void value(T number) {
+        if constexpr (std::is_signed_v<T>) {
+            if (number < 0) {
+                write_negative(static_cast<int64_t>(number));
+                return;
+            }
+        }
+
+        write_unsigned(static_cast<uint64_t>(number));
+    }
+
+    void null() {
+        put(format == binary_format::CBOR ? 0xf6 : 0xc0);
+    }
+
+    // key and value in one go
+    template<typename T>
+    void field(std::string_view name, const T &field_value) {
+        key(name);
+        value(field_value);
+    }
+
+    // hand everything written so far to the stream
+    void flush() {
+        if (!buffer.empty()) {
+            os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+private:
+    static constexpr size_t flush_threshold = 64 * 1024;
+
+    void put(uint8_t byte) {
+        buffer.push_back(static_cast<char>(byte));
+    }
+
+    template<typename T>
+    void put_big_endian(uint64_t number) {
+        for (int shift = (sizeof(T) - 1) * 8; shift >= 0; shift -= 8) {
+            put(static_cast<uint8_t>(number >> shift));
+        }
+    }
+
+    void flush_if_full() {
+        if (buffer.size() >= flush_threshold) {
+            flush();
+        }
+    }
+
+    // the major type in the top 3 bits, followed by the smallest encoding of the argument
+    void write_cbor_header(uint8_t major_type, uint64_t argument) {
+        const uint8_t major = static_cast<uint8_t>(major_type << 5);
+
+        if (argument < 24) {
+            put(static_cast<uint8_t>(major | argument));
+        } else if (argument <= UINT8_MAX) {
+            put(major | 24);
+            put_big_endian<uint8_t>(argument);
+        } else if (argument <= UINT16_MAX) {
+            put(major | 25);
+            put_big_endian<uint16_t>(argument);
+        } else if (argument <= UINT32_MAX) {
+            put(major | 26);
+            put_big_endian<uint32_t>(argument);
+        } else {
+            put(major | 27);
+            put_big_endian<uint64_t>(argument);
+        }
+    }
+
+    // MessagePack containers have a fix form for up to 15 members, then 16 and 32 bit counts
+    void write_msgpack_header(uint8_t fix_prefix, uint8_t prefix16, uint8_t prefix32, size_t count) {
+        if (count < 16) {
+            put(static_cast<uint8_t>(fix_prefix | count));
+        } else if (count <= UINT16_MAX) {
+            put(prefix16);
+            put_big_endian<uint16_t>(count);
+        } else {
+            put(prefix32);
+            put_big_endian<uint32_t>(count);
+        }
+    }
+
+    void write_unsigned(uint64_t number) {
+        if (format == binary_format::CBOR) {
+            write_cbor_header(0, number);
+        } else if (number < 128) {
+            put(static_cast<uint8_t>(number));
+        } else if (number <= UINT8_MAX) {
+            put(0xcc);
+            put_big_endian<uint8_t>(number);
+        } else if (number <= UINT16_MAX) {
+            put(0xcd);
+            put_big_endian<uint16_t>(number);
+        } else if (number <= UINT32_MAX) {
+            put(0xce);
+            put_big_endian<uint32_t>(number);
+        } else {
+            put(0xcf);
+            put_big_endian<uint64_t>(number);
+        }
+    }
+
+    void write_negative(int64_t number) {
+        if (format == binary_format::CBOR) {
+            // stored as -1 - n
+            write_cbor_header(1, static_cast<uint64_t>(-(number + 1)));
+        } else if (number >= -32) {
+            put(static_cast<uint8_t>(number));
+        } else if (number >= INT8_MIN) {
+            put(0xd0);
+            put_big_endian<uint8_t>(static_cast<uint64_t>(number));
+        } else if (number >= INT16_MIN) {
+            put(0xd1);
+            put_big_endian<uint16_t>(static_cast<uint64_t>(number));
+        } else if (number >= INT32_MIN) {
+            put(0xd2);
+            put_big_endian<uint32_t>(static_cast<uint64_t>(number));
+        } else {
+            put(0xd3);
+            put_big_endian<uint64_t>(static_cast<uint64_t>(number));
+        }
+    }
+
+    std::ostream &os;
+
+    binary_format format{};
+
+    std::string buffer{};
+};
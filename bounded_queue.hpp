@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// A fixed size lock-free multi-producer/multi-consumer queue.
+// Every cell carries a sequence number telling producers and consumers
+// whose turn it is, so pushing and popping is a single CAS on the fast path.
+// Once every producer is done the queue can be closed, which lets consumers
+// drain what's left and then stop.
+// push and pop spin for a few rounds and then sleep until the other side makes progress,
+// try_push and try_pop never wait or lock.
+template<typename T>
+class bounded_queue {
+public:
+
+    // capacity is rounded up to the next power of two
+    explicit bounded_queue(size_t capacity) {
+
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+
+        mask = size - 1;
+        cells = std::make_unique<cell[]>(size);
+
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bounded_queue(const bounded_queue &) = delete;
+    bounded_queue &operator=(const bounded_queue &) = delete;
+
+    // returns false if the queue is full, value is left untouched then
+    bool try_push(T &&value) {
+
+        cell *target = nullptr;
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+        while (true) {
+            target = &cells[pos & mask];
+            const size_t sequence = target->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+
+            if (difference == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        target->value = std::move(value);
+        target->sequence.store(pos + 1, std::memory_order_release);
+
+        wake_parked(parked_consumers, not_empty);
+        return true;
+    }
+
+    // returns false if the queue is empty
+    bool try_pop(T &out) {
+
+        cell *target = nullptr;
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+
+        while (true) {
+            target = &cells[pos & mask];
+            const size_t sequence = target->sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+
+            if (difference == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (difference < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        out = std::move(target->value);
+        target->value = T{};
+        target->sequence.store(pos + mask + 1, std::memory_order_release);
+
+        wake_parked(parked_producers, not_full);
+        return true;
+    }
+
+    // waits until the value is pushed or cancelled turns true
+    // returns false if it was cancelled
+    bool push(T &&value, const std::atomic<bool> &cancelled) {
+
+        for (uint32_t round = 0; !try_push(std::move(value)); ++round) {
+            if (cancelled.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (round < spin_rounds) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            park(parked_producers, not_full, [&]() { return has_room() || cancelled.load(std::memory_order_relaxed); });
+        }
+
+        return true;
+    }
+
+    // waits until a value is popped, the queue is closed and drained or cancelled turns true
+    // returns false if there's nothing left to pop
+    bool pop(T &out, const std::atomic<bool> &cancelled) {
+
+        for (uint32_t round = 0; !try_pop(out); ++round) {
+            if (closed.load(std::memory_order_acquire)) {
+                // something could have been pushed right before closing
+                return try_pop(out);
+            }
+            if (cancelled.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            if (round < spin_rounds) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            park(parked_consumers, not_empty, [&]() {
+                return has_value() || closed.load(std::memory_order_acquire) || cancelled.load(std::memory_order_relaxed);
+            });
+        }
+
+        return true;
+    }
+
+    // tell consumers that nothing else is going to be pushed
+    void close() {
+        closed.store(true, std::memory_order_release);
+        wake_all();
+    }
+
+    // wake everyone sleeping in push or pop, e.g. after turning their cancelled flag true
+    void wake_all() {
+        std::unique_lock<decltype(park_mutex)> lock(park_mutex);
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+private:
+
+    // how often push and pop retry before they go to sleep
+    static constexpr uint32_t spin_rounds = 64;
+
+    struct cell {
+        std::atomic<size_t> sequence{};
+        T value{};
+    };
+
+    std::unique_ptr<cell[]> cells{};
+    size_t mask{};
+
+    // keep the producer and consumer positions on their own cache lines
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+
+    std::atomic<bool> closed{false};
+
+    // whether the next push or pop would go through right now
+    bool has_room() const {
+        const size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+    bool has_value() const {
+        const size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    // sleep on condition until ready() holds, counted in parked so the other side knows to wake us
+    template<typename ready_t>
+    void park(std::atomic<uint32_t> &parked, std::condition_variable &condition, const ready_t &ready) {
+        std::unique_lock<decltype(park_mutex)> lock(park_mutex);
+        parked.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        condition.wait(lock, ready);
+        parked.fetch_sub(1);
+    }
+
+    // wake a single sleeper after a push or pop, if there is any
+    // pairs with the fence in park: either we see the sleeper or it sees the cell we just handed over
+    void wake_parked(const std::atomic<uint32_t> &parked, std::condition_variable &condition) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (parked.load(std::memory_order_relaxed) != 0) {
+            std::unique_lock<decltype(park_mutex)> lock(park_mutex);
+            condition.notify_one();
+        }
+    }
+
+    std::mutex park_mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::atomic<uint32_t> parked_producers{0};
+    std::atomic<uint32_t> parked_consumers{0};
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Writes JSON straight to a stream as values are handed to it, without
+// building a tree first. The caller is responsible for pairing every
+// begin_* with its end_* and for putting a key before every object member.
+class json_writer {
+public:
+    explicit json_writer(std::ostream &_os) : os(_os) {
+        buffer.reserve(flush_threshold + 1024);
+    }
+
+    ~json_writer() {
+        flush();
+    }
+
+    json_writer(const json_writer &) = delete;
+    json_writer &operator=(const json_writer &) = delete;
+
+    // the member count is only needed by binary_writer, json doesn't care
+    void begin_object(size_t = 0) {
+        begin_value();
+        buffer.push_back('{');
+        scopes.push_back(true);
+    }
+
+    void end_object() {
+        scopes.pop_back();
+        buffer.push_back('}');
+        flush_if_full();
+    }
+
+    void begin_array(size_t = 0) {
+        begin_value();
+        buffer.push_back('[');
+        scopes.push_back(true);
+    }
+
+    void end_array() {
+        scopes.pop_back();
+        buffer.push_back(']');
+        flush_if_full();
+    }
+
+    void key(std::string_view name) {
+        begin_value();
+        write_string(name);
+        buffer.push_back(':');
+        after_key = true;
+    }
+
+    void value(std::string_view text) {
+        begin_value();
+        write_string(text);
+    }
+
+    void value(const char *text) {
+        value(std::string_view(text));
+    }
+
+    void value(bool boolean) {
+        begin_value();
+        buffer.append(boolean ? "true" : "false");
+    }
+
+    template<typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    void value(T number) {
+        begin_value();
+
+        char digits[24];
+        const auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), number);
+        buffer.append(digits, end);
+    }
+
+    // a number with a fixed amount of decimals, handed over scaled up by 10^decimals
+    // e.g. decimal(12345, 3) writes 12.345
+    void decimal(uint64_t scaled, uint32_t decimals) {
+        begin_value();
+
+        uint64_t divisor = 1;
+        for (uint32_t i = 0; i < decimals; ++i) {
+            divisor *= 10;
+        }
+
+        char digits[24];
+        const auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), scaled / divisor);
+        buffer.append(digits, end);
+
+        if (decimals == 0) {
+            return;
+        }
+
+        // the fraction with its leading zeros
+        char fraction[24];
+        uint64_t remainder = scaled % divisor;
+        for (uint32_t i = decimals; i > 0; --i) {
+            fraction[i] = static_cast<char>('0' + remainder % 10);
+            remainder /= 10;
+        }
+        fraction[0] = '.';
+        buffer.append(fraction, decimals + 1);
+    }
+
+    void null() {
+        begin_value();
+        buffer.append("null");
+    }
+
+    // end a top level value, for newline delimited output
+    void newline() {
+        buffer.push_back('\n');
+        flush_if_full();
+    }
+
+    // key and value in one go
+    template<typename T>
+    void field(std::string_view name, const T &field_value) {
+        key(name);
+        value(field_value);
+    }
+
+    // hand everything written so far to the stream
+    void flush() {
+        if (!buffer.empty()) {
+            os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+private:
+    static constexpr size_t flush_threshold = 64 * 1024;
+
+    // separate the value from the previous one unless it follows a key
+    void begin_value() {
+        if (after_key) {
+            after_key = false;
+            return;
+        }
+
+        if (!scopes.empty()) {
+            if (!scopes.back()) {
+                buffer.push_back(',');
+            }
+            scopes.back() = false;
+        }
+    }
+
+    void flush_if_full() {
+        if (buffer.size() >= flush_threshold) {
+            flush();
+        }
+    }
+
+    // quote and escape a string, copying unescaped runs at once
+    void write_string(std::string_view text) {
+        static constexpr char hex_digits[] = "0123456789abcdef";
+
+        buffer.push_back('"');
+
+        size_t run_start = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            const auto c = static_cast<unsigned char>(text[i]);
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+
+            buffer.append(text.data() + run_start, i - run_start);
+            run_start = i + 1;
+
+            switch (c) {
+                case '"': buffer.append("\\\""); break;
+                case '\\': buffer.append("\\\\"); break;
+                case '\b': buffer.append("\\b"); break;
+                case '\f': buffer.append("\\f"); break;
+                case '\n': buffer.append("\\n"); break;
+                case '\r': buffer.append("\\r"); break;
+                case '\t': buffer.append("\\t"); break;
+                default: {
+                    const char escaped[] = {'\\', 'u', '0', '0', hex_digits[c >> 4], hex_digits[c & 0xF]};
+                    buffer.append(escaped, sizeof(escaped));
+                    break;
+                }
+            }
+        }
+
+        buffer.append(text.data() + run_start, text.size() - run_start);
+        buffer.push_back('"');
+
+        flush_if_full();
+    }
+
+    std::ostream &os;
+
+    std::string buffer{};
+
+    // one entry per open object or array, true until its first value is written
+    std::vector<bool> scopes{};
+
+    // the next value belongs to the key that was just written
+    bool after_key = false;
+};
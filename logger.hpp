@@ -1,14 +1,40 @@
 #pragma once
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
-
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
 #include <iostream>
 #include <mutex>
-#include <unordered_map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 
+#include "bounded_queue.hpp"
 #include "utils.hpp"
 
+// SCRAPER_LIBRARY builds the scraper to be embedded into another process (see scraper_api.h)
+// the logger then never touches the console and discards everything until rpgms_set_log hands it a stream
+
+// the least severe level that's compiled in at all, in log_level order
+// anything above it compiles to nothing, e.g. -DLOG_COMPILE_LEVEL=2 keeps fatal, error and warn
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 5
+#endif
+
 enum class log_level : std::uint32_t {
     LOG_FATAL,
     LOG_ERROR,
@@ -19,32 +45,13 @@ enum class log_level : std::uint32_t {
     LOG_NOPREFIX, // keep this last
 };
 
+// Formats messages on the calling thread into fixed size records and pushes
+// them onto a lock-free ring buffer. A background thread drains the buffer
+// and writes whatever piled up in one go, so logging never waits on the console.
+// Once nothing has been logged for a while the thread sleeps until the next message.
 class logger {
 public:
 
-    logger(const std::wstring_view &title_name = {}) {
-
-        AllocConsole();
-        AttachConsole(GetCurrentProcessId());
-
-        if (!title_name.empty()) {
-            SetConsoleTitle(title_name.data());
-        }
-
-        FILE *in = nullptr;
-        FILE *out = nullptr;
-
-        freopen_s(&in, "conin$", "r", stdin);
-        freopen_s(&out, "conout$", "w", stdout);
-        freopen_s(&out, "conout$", "w", stderr);
-
-        console_handle = GetStdHandle(STD_OUTPUT_HANDLE);
-    }
-
-    ~logger() {
-        FreeConsole();
-    }
-
     enum class console_colors : std::uint8_t {
         BLACK,
         DARK_BLUE,
@@ -66,107 +73,454 @@ public:
 
     struct log_type_info_t {
 
-        std::string prefix{};
+        std::string_view prefix{};
         console_colors fg = console_colors::WHITE;
         console_colors bg = console_colors::BLACK;
-
-        log_type_info_t() = default;
     };
 
-    template<typename ... arg>
-    void print_colored(console_colors fg, console_colors bg, bool newline, std::string_view fmt, arg ... args) {
+    // the process wide logger, created on first use
+    static logger &get() {
+        static logger instance(L"~ rpgmaker scraper by nit ~");
+        return instance;
+    }
+
+    logger(const std::wstring_view &title_name = {}) {
 
-        std::unique_lock< decltype(m)> lock(m);
+#if defined(_WIN32) && !defined(SCRAPER_LIBRARY)
+        AllocConsole();
+        AttachConsole(GetCurrentProcessId());
 
-        const auto txt = utils::format_string(fmt, args...);
+        if (!title_name.empty()) {
+            SetConsoleTitleW(title_name.data());
+        }
 
-        set_console_color(fg, bg);
+        FILE *in = nullptr;
+        FILE *out = nullptr;
 
-        std::cout << txt.c_str();
+        freopen_s(&in, "conin$", "r", stdin);
+        freopen_s(&out, "conout$", "w", stdout);
+        freopen_s(&out, "conout$", "w", stderr);
 
-        set_console_color(console_colors::WHITE, console_colors::BLACK);
+        // colors are written as escape sequences
+        for (const auto handle_id : {STD_OUTPUT_HANDLE, STD_ERROR_HANDLE}) {
+            const HANDLE handle = GetStdHandle(handle_id);
 
-        if (newline) {
-            std::cout << std::endl;
+            DWORD console_mode = 0;
+            if (GetConsoleMode(handle, &console_mode)) {
+                SetConsoleMode(handle, console_mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+            }
         }
+#else
+        (void)title_name;
+#endif
+
+#ifdef SCRAPER_LIBRARY
+        // only fatal errors are formatted, and thrown away, until rpgms_set_log asks for more
+        stream = &discarded;
+        max_level.store(log_level::LOG_FATAL);
+#else
+        use_colors.store(is_terminal(stdout));
+#endif
+
+        drain_thread = std::thread(&logger::drain, this);
     }
 
-    template< typename ... arg >
-    void print(log_level level, std::string_view fmt, arg ... args) {
+    ~logger() {
 
-        std::unique_lock< decltype(m)> lock(m);
+        running.store(false);
+        {
+            std::unique_lock<decltype(wake_mutex)> lock(wake_mutex);
+            wake.notify_one();
+        }
+        drain_thread.join();
 
-        const auto &info = console_type_info[level];
-        const auto txt = utils::format_string(fmt, args...);
+#if defined(_WIN32) && !defined(SCRAPER_LIBRARY)
+        FreeConsole();
+#endif
+    }
 
-        set_console_color(info.fg, info.bg);
+    logger(const logger &) = delete;
+    logger &operator=(const logger &) = delete;
 
-        if (level < log_level::LOG_NOPREFIX) {
-            std::cout << info.prefix;
+    // fmt is made with format_literal, the log macros do that on their own
+    template<typename format_t, typename ... arg>
+    __forceinline void print_colored(console_colors fg, console_colors bg, bool newline, format_t fmt, arg ... args) {
+        write_colored(fg, bg, newline, utils::check_format<arg...>(fmt), args...);
+    }
+
+    template<typename format_t, typename ... arg>
+    __forceinline void print(log_level level, format_t fmt, arg ... args) {
+        write(level, utils::check_format<arg...>(fmt), args...);
+    }
+
+    template<typename format_t, typename ... arg>
+    __forceinline void print_with_func(log_level level, std::string_view func_name, format_t fmt, arg ... args) {
+        write_with_func(level, func_name, utils::check_format<arg...>(fmt), args...);
+    }
+
+    // whether messages of this level are written, messages without a prefix always are
+    __forceinline bool is_enabled(log_level level) const {
+        return level == log_level::LOG_NOPREFIX || level <= max_level.load(std::memory_order_relaxed);
+    }
+
+    // the least severe level that's still written
+    void set_level(log_level level) {
+        max_level.store(level, std::memory_order_relaxed);
+    }
+
+    // parse a level by its name, e.g. "warn"
+    static std::optional<log_level> parse_level(std::string_view name) {
+
+        static constexpr std::array<std::pair<std::string_view, log_level>, 6> names = {{
+            {"fatal", log_level::LOG_FATAL},
+            {"error", log_level::LOG_ERROR},
+            {"warn", log_level::LOG_WARN},
+            {"ok", log_level::LOG_OK},
+            {"info", log_level::LOG_INFO},
+            {"debug", log_level::LOG_DEBUG},
+        }};
+
+        for (const auto &[level_name, level] : names) {
+            if (level_name == name) {
+                return level;
+            }
         }
 
-        std::cout << txt.c_str();
+        return std::nullopt;
+    }
 
-        set_console_color(console_colors::WHITE, console_colors::BLACK);
+    // wait until everything logged so far has been written
+    void flush() {
 
-        std::cout << std::endl;
+        const uint64_t target = pushed.load();
+        if (written.load() >= target) {
+            return;
+        }
+
+        flushing.fetch_add(1);
+        {
+            std::unique_lock<decltype(wake_mutex)> lock(wake_mutex);
+            flushed.wait(lock, [&]() { return written.load() >= target; });
+        }
+        flushing.fetch_sub(1);
     }
 
-    template< typename ... arg >
-    void print_with_func(log_level level, std::string_view func_name, std::string_view fmt, arg ... args) {
+    // send all output to another stream, e.g. to keep stdout free for machine readable output
+    void set_stream(std::ostream &_stream) {
 
-        std::unique_lock< decltype(m)> lock(m);
+        flush();
 
-        const auto &info = console_type_info[level];
-        const auto txt = utils::format_string(fmt, args...);
+        std::unique_lock< decltype(stream_mutex)> lock(stream_mutex);
 
-        set_console_color(info.fg, info.bg);
+        stream->flush();
+        stream = &_stream;
 
-        if (level < log_level::LOG_NOPREFIX) {
-            std::cout << info.prefix;
+        if (stream == &std::cout) {
+            use_colors.store(is_terminal(stdout));
+        } else if (stream == &std::cerr) {
+            use_colors.store(is_terminal(stderr));
+        } else {
+            use_colors.store(false);
         }
+    }
+
+    // write an already formatted block of text in a single call, after everything logged so far
+    void write_raw(std::string_view text) {
+
+        flush();
 
-        std::cout << "[ " << func_name.data() << " ] " << txt.c_str();
+        std::unique_lock< decltype(stream_mutex)> lock(stream_mutex);
 
-        set_console_color(console_colors::WHITE, console_colors::BLACK);
+        stream->write(text.data(), static_cast<std::streamsize>(text.size()));
+        stream->flush();
+    }
+
+    // whether stdin is a console someone can answer a prompt from
+    static bool is_interactive() {
+        return is_terminal(stdin);
+    }
 
-        std::cout << std::endl;
+    // whether the output goes to a terminal that understands colors
+    __forceinline bool colors_enabled() const {
+        return use_colors.load(std::memory_order_relaxed);
     }
 
+    // the escape sequence switching to the given colors
+    // the default white on black is left to the terminal
+    static std::string_view format_color(console_colors fg, console_colors bg, char (&buffer)[16]) {
+
+        // console attribute order -> ANSI color codes
+        static constexpr uint8_t ansi_codes[] = {
+            30, 34, 32, 36, 31, 35, 33, 37,
+            90, 94, 92, 96, 91, 95, 93, 97,
+        };
+
+        if (fg == console_colors::WHITE && bg == console_colors::BLACK) {
+            return {};
+        }
+
+        const int fg_code = ansi_codes[static_cast<uint8_t>(fg) & 0xF];
+        const int bg_code = ansi_codes[static_cast<uint8_t>(bg) & 0xF] + 10;
+
+        char *cursor = buffer;
+        *cursor++ = '\x1b';
+        *cursor++ = '[';
+        cursor = std::to_chars(cursor, std::end(buffer), fg_code).ptr;
+        if (bg != console_colors::BLACK) {
+            *cursor++ = ';';
+            cursor = std::to_chars(cursor, std::end(buffer), bg_code).ptr;
+        }
+        *cursor++ = 'm';
+
+        return {buffer, static_cast<size_t>(cursor - buffer)};
+    }
+
+    static constexpr std::string_view color_reset = "\x1b[0m";
+
 private:
-    inline bool set_console_color(const console_colors fg, const console_colors bg) {
 
-        if (console_handle != INVALID_HANDLE_VALUE) {
-            WORD color = (uint8_t)fg | ((uint8_t)bg << 4);
-            return SetConsoleTextAttribute(console_handle, color);
+    // the print functions once their format is checked
+    template<typename ... arg>
+    void write_colored(console_colors fg, console_colors bg, bool newline, std::string_view fmt, arg ... args) {
+
+        log_record record{};
+        char color[16];
+
+        record.append(get_color(fg, bg, color));
+        utils::detail::format_unchecked(record, fmt, args...);
+        record.append(get_reset(fg, bg));
+
+        if (newline) {
+            record.push_back('\n');
         }
 
-        return false;
+        push(std::move(record));
     }
 
-    std::unordered_map< log_level, log_type_info_t > console_type_info = {
-        {log_level::LOG_FATAL, {"[ ! ] ", console_colors::RED, console_colors::WHITE}},
-        {log_level::LOG_ERROR, {"[ - ] ", console_colors::RED, console_colors::BLACK}},
-        {log_level::LOG_WARN, {"[ # ] ", console_colors::BLACK, console_colors::YELLOW}},
-        {log_level::LOG_OK, {"[ + ] ", console_colors::GREEN, console_colors::BLACK}},
-        {log_level::LOG_INFO, {"[ ~ ] ", console_colors::WHITE, console_colors::BLACK}},
-        {log_level::LOG_DEBUG, {"      ", console_colors::DARK_GRAY, console_colors::BLACK}},
-    };
+    template< typename ... arg >
+    void write(log_level level, std::string_view fmt, arg ... args) {
+
+        const auto &info = console_type_info[static_cast<size_t>(level)];
+
+        log_record record{};
+        char color[16];
+
+        record.append(get_color(info.fg, info.bg, color));
+        record.append(info.prefix);
+        utils::detail::format_unchecked(record, fmt, args...);
+        record.append(get_reset(info.fg, info.bg));
+        record.push_back('\n');
+
+        push(std::move(record));
+    }
+
+    template< typename ... arg >
+    void write_with_func(log_level level, std::string_view func_name, std::string_view fmt, arg ... args) {
+
+        const auto &info = console_type_info[static_cast<size_t>(level)];
+
+        log_record record{};
+        char color[16];
+
+        record.append(get_color(info.fg, info.bg, color));
+        record.append(info.prefix);
+        record.append("[ ");
+        record.append(func_name);
+        record.append(" ] ");
+        utils::detail::format_unchecked(record, fmt, args...);
+        record.append(get_reset(info.fg, info.bg));
+        record.push_back('\n');
+
+        push(std::move(record));
+    }
+
+    // a single formatted message waiting to be written
+    // messages that don't fit inline spill over to the heap
+    using log_record = utils::small_string<240>;
+
+    static bool is_terminal(FILE *file) {
+#ifdef _WIN32
+        return _isatty(_fileno(file)) != 0;
+#else
+        return isatty(fileno(file)) != 0;
+#endif
+    }
+
+    std::string_view get_color(console_colors fg, console_colors bg, char (&buffer)[16]) const {
+
+        if (!colors_enabled()) {
+            return {};
+        }
+
+        return format_color(fg, bg, buffer);
+    }
+
+    std::string_view get_reset(console_colors fg, console_colors bg) const {
+
+        if (!colors_enabled() || (fg == console_colors::WHITE && bg == console_colors::BLACK)) {
+            return {};
+        }
+
+        return color_reset;
+    }
+
+    void push(log_record &&record) {
+
+        // counted before it's queued, so flush() can't miss a record that's about to be written
+        pushed.fetch_add(1);
+        records.push(std::move(record), never_cancelled);
+
+        // only a sleeping drain thread needs the lock, a busy one picks the record up by itself
+        // parked is set before the drain thread checks pushed one last time, so it can't miss this record
+        if (parked.load()) {
+            std::unique_lock<decltype(wake_mutex)> lock(wake_mutex);
+            wake.notify_one();
+        }
+    }
+
+    // write out whatever is queued in batches until the logger goes away
+    void drain() {
+
+        std::string batch{};
+        batch.reserve(batch_size);
+
+        log_record record{};
+        uint64_t popped = 0;
+        uint32_t idle_rounds = 0;
+
+        while (true) {
+
+            const bool stopping = !running.load(std::memory_order_acquire);
+
+            while (batch.size() < batch_size && records.try_pop(record)) {
+                batch.append(record.view());
+                ++popped;
+            }
+
+            if (!batch.empty()) {
+                {
+                    std::unique_lock< decltype(stream_mutex)> lock(stream_mutex);
+                    stream->write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                    stream->flush();
+                }
+
+                batch.clear();
+                written.store(popped);
+                idle_rounds = 0;
+
+                if (flushing.load() != 0) {
+                    std::unique_lock<decltype(wake_mutex)> lock(wake_mutex);
+                    flushed.notify_all();
+                }
+                continue;
+            }
+
+            if (stopping) {
+                break;
+            }
+
+            // messages tend to come in bursts, so spin for a bit before going to sleep
+            if (++idle_rounds < 64) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            {
+                std::unique_lock<decltype(wake_mutex)> lock(wake_mutex);
+                parked.store(true);
+                wake.wait(lock, [&]() { return pushed.load() != popped || !running.load(); });
+                parked.store(false);
+            }
+            idle_rounds = 0;
+        }
+    }
 
-    std::mutex m;
-    HANDLE console_handle = INVALID_HANDLE_VALUE;
+    static constexpr size_t queue_capacity = 1024;
+    static constexpr size_t batch_size = 64 * 1024;
+
+    const std::array<log_type_info_t, static_cast<size_t>(log_level::LOG_NOPREFIX) + 1> console_type_info = {{
+        {"[ ! ] ", console_colors::RED, console_colors::WHITE},
+        {"[ - ] ", console_colors::RED, console_colors::BLACK},
+        {"[ # ] ", console_colors::BLACK, console_colors::YELLOW},
+        {"[ + ] ", console_colors::GREEN, console_colors::BLACK},
+        {"[ ~ ] ", console_colors::WHITE, console_colors::BLACK},
+        {"      ", console_colors::DARK_GRAY, console_colors::BLACK},
+        {"", console_colors::WHITE, console_colors::BLACK},
+    }};
+
+    bounded_queue<log_record> records{queue_capacity};
+    const std::atomic<bool> never_cancelled{false};
+
+    // every atomic the drain thread sleeps and wakes on is sequentially consistent,
+    // a producer either sees it parked or it sees the producer's record counted
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    std::atomic<bool> parked{false};
+    std::atomic<uint32_t> flushing{0};
+
+    std::atomic<uint64_t> pushed{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<bool> running{true};
+
+    std::atomic<log_level> max_level{log_level::LOG_INFO};
+
+    std::mutex stream_mutex;
+    std::ostream *stream = &std::cout;
+#ifdef SCRAPER_LIBRARY
+    // has no buffer, so whatever is written to it goes nowhere
+    std::ostream discarded{nullptr};
+#endif
+    std::atomic<bool> use_colors{false};
+
+    std::thread drain_thread{};
 };
 
-inline auto g_logger = std::make_unique< logger >(L"~ rpgmaker scraper by nit ~");
-#define log_colored_nnl(fg, bg, ...) g_logger->print_colored(fg, bg, false, __VA_ARGS__)
-#define log_colored( fg, bg, ... ) g_logger->print_colored( fg, bg, true, __VA_ARGS__ )
-#define _log(log_type, ...) g_logger->print( log_type, __VA_ARGS__ )
-#define _log_with_func(log_type, ...) g_logger->print_with_func( log_type, __FUNCTION__, __VA_ARGS__ )
-
-#define log_fatal( ... ) _log( log_level::LOG_FATAL, __VA_ARGS__ )
-#define log_err( ... ) _log( log_level::LOG_ERROR, __VA_ARGS__ )
-#define log_warn( ... ) _log( log_level::LOG_WARN, __VA_ARGS__ )
-#define log_ok( ... ) _log( log_level::LOG_OK, __VA_ARGS__ )
-#define log_info( ... ) _log( log_level::LOG_INFO, __VA_ARGS__ )
-#define log_dbg( ... ) _log( log_level::LOG_DEBUG, __VA_ARGS__ )
-#define log_nopre( ... ) _log( log_level::LOG_NOPREFIX, __VA_ARGS__ )
+// every macro takes a format literal and checks it against the arguments when compiling
+#define log_colored_nnl(fg, bg, fmt, ...) logger::get().print_colored(fg, bg, false, format_literal(fmt), ##__VA_ARGS__)
+#define log_colored( fg, bg, fmt, ... ) logger::get().print_colored( fg, bg, true, format_literal(fmt), ##__VA_ARGS__ )
+
+// the arguments are only evaluated if the level is enabled
+#define _log(log_type, fmt, ...) (logger::get().is_enabled(log_type) ? logger::get().print( log_type, format_literal(fmt), ##__VA_ARGS__ ) : (void)0)
+#define _log_with_func(log_type, fmt, ...) (logger::get().is_enabled(log_type) ? logger::get().print_with_func( log_type, __FUNCTION__, format_literal(fmt), ##__VA_ARGS__ ) : (void)0)
+
+// levels above LOG_COMPILE_LEVEL compile to nothing
+#define _log_disabled( ... ) ((void)0)
+
+#if LOG_COMPILE_LEVEL >= 0
+#define log_fatal( fmt, ... ) _log( log_level::LOG_FATAL, fmt, ##__VA_ARGS__ )
+#else
+#define log_fatal( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#if LOG_COMPILE_LEVEL >= 1
+#define log_err( fmt, ... ) _log( log_level::LOG_ERROR, fmt, ##__VA_ARGS__ )
+#else
+#define log_err( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#if LOG_COMPILE_LEVEL >= 2
+#define log_warn( fmt, ... ) _log( log_level::LOG_WARN, fmt, ##__VA_ARGS__ )
+#else
+#define log_warn( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#if LOG_COMPILE_LEVEL >= 3
+#define log_ok( fmt, ... ) _log( log_level::LOG_OK, fmt, ##__VA_ARGS__ )
+#else
+#define log_ok( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#if LOG_COMPILE_LEVEL >= 4
+#define log_info( fmt, ... ) _log( log_level::LOG_INFO, fmt, ##__VA_ARGS__ )
+#else
+#define log_info( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#if LOG_COMPILE_LEVEL >= 5
+#define log_dbg( fmt, ... ) _log( log_level::LOG_DEBUG, fmt, ##__VA_ARGS__ )
+#else
+#define log_dbg( ... ) _log_disabled( __VA_ARGS__ )
+#endif
+
+#define log_nopre( fmt, ... ) _log( log_level::LOG_NOPREFIX, fmt, ##__VA_ARGS__ )
@@ -1,10 +1,53 @@
 #include "logger.hpp"
+#include "memory_usage.hpp"
+#include "perf_counters.hpp"
+#include "result_sink.hpp"
+#include "rpgmaker_project.hpp"
 #include "rpgmaker_scraper.hpp"
+#include "scrape_pipeline.hpp"
+#include "stats.hpp"
+#include "tracer.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
 
 using colors = logger::console_colors;
 
+// what the program returns, so scripts can tell the outcomes apart
+enum exit_code : int {
+    // every query found at least one reference
+    EXIT_FOUND = 0,
+    // a query ran fine but found nothing
+    EXIT_NOT_FOUND = 1,
+    // bad usage, a bad query or the project couldn't be scraped
+    EXIT_ERROR = 2,
+};
+
+constexpr const char *search_type_variables = "-v";
+constexpr const char *search_type_switches = "-s";
+constexpr const char *as_json = ".json";
+constexpr const char *as_cbor = ".cbor";
+constexpr const char *as_msgpack = ".msgpack";
+constexpr const char *as_ndjson = ".ndjson";
+constexpr const char *to_stdout = "-";
+
+// how the hits of every query are ordered, trimmed and output
+struct output_options {
+    size_t hit_limit = 0;
+    size_t hit_offset = 0;
+    HitOrder hit_order = HitOrder::MAP;
+    bool count_only = false;
+
+    // only the hits that end up in the output are kept, so nothing else gets formatted
+    bool window_hits() const {
+        return hit_limit || hit_offset;
+    }
+};
+
 bool string_ends_with(std::string str, std::string suffix) {
     return str.size() >= suffix.size() &&
         str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
@@ -15,94 +58,532 @@ void print_usage() {
                 "incorrect usage - please use the program like so:\n"
                 "RPGMakerScraper -v 143 test_output.txt\n"
                 "RPGMakerScraper -s 21\n"
-                "RPGMakerScraper -s 714 test_output.json");
+                "RPGMakerScraper -s 714 test_output.json\n"
+                "RPGMakerScraper -v 143 test_output.cbor\n"
+                "RPGMakerScraper -v 143 --low-memory\n"
+                "RPGMakerScraper -v 143 --log-level warn\n"
+                "RPGMakerScraper -v 143 --ndjson -\n"
+                "RPGMakerScraper -s 21 test_output.ndjson\n"
+                "RPGMakerScraper -v 143 --limit 50 --offset 100\n"
+                "RPGMakerScraper -v 143 --sort access|event|map\n"
+                "RPGMakerScraper -v 143 --count-only\n"
+                "RPGMakerScraper --batch queries.txt (one '-v 143 [output file]' per line, - reads stdin, no --low-memory or --ndjson)\n"
+                "RPGMakerScraper -v 143 --stats\n"
+                "RPGMakerScraper -v 143 --stats-json stats.json\n"
+                "RPGMakerScraper -v 143 --memory\n"
+                "RPGMakerScraper -v 143 --memory-json memory.json\n"
+                "RPGMakerScraper -v 143 --trace trace.json\n"
+                "RPGMakerScraper -v 143 --perf-counters (linux only)");
 }
 
-int main(int argc, const char *argv[]) {
+// turn a search type and id like '-v' '143' into what to scrape for
+// logs what's wrong and returns nothing if either is invalid
+std::optional<std::pair<ScrapeMode, uint32_t>> parse_query(const std::string &search_type, const std::string &id_str) {
 
-    constexpr uint32_t expected_minimum_argc = 3;
+    std::optional<ScrapeMode> mode{};
+    if (search_type == search_type_variables) {
+        mode = ScrapeMode::VARIABLES;
+    } else if (search_type == search_type_switches) {
+        mode = ScrapeMode::SWITCHES;
+    }
 
-    constexpr const char *search_type_variables = "-v";
-    constexpr const char *search_type_switches = "-s";
-    constexpr const char *as_json = ".json";
+    if (!mode) {
+        log_err(R"(unsupported search type '%s', use -v or -s.)", search_type.data());
+        return std::nullopt;
+    }
 
-    // check the argument count
-    if (argc < expected_minimum_argc) {
-        print_usage();
-        return 1;
+    // make sure this id is actually a number
+    uint32_t id = 0;
+    const auto [end, error] = std::from_chars(id_str.data(), id_str.data() + id_str.size(), id);
+
+    if (error != std::errc{} || end != id_str.data() + id_str.size()) {
+        log_err(R"(invalid %s id. Please provide a number.")", (*mode == ScrapeMode::VARIABLES ? "variable" : "switch"));
+        return std::nullopt;
     }
 
-    const std::string search_type{argv[1]};
-    const std::string id_str{argv[2]};
+    return std::make_pair(*mode, id);
+}
 
-    const bool output_to_file = argc == 4;
+// sort the hits and drop the ones outside the wanted window
+void arrange_results(ScrapeResults &results, const output_options &options) {
 
-    // make sure this id is actually a number
-    if (!std::all_of(id_str.begin(), id_str.end(), isdigit)) {
+    if (options.count_only) {
+        return;
+    }
 
-        const auto get_type_name = [&](std::string search_type) -> std::string {
-            static std::unordered_map<std::string, std::string> types = {
-                {search_type_variables, "variable"},
-                {search_type_switches, "switch"},
-            };
+    results.sort_hits(options.hit_order);
 
-            if (types.find(search_type) != types.end()) {
-                return types.at(search_type);
-            }
+    if (options.window_hits()) {
+        results.limit_hits(options.hit_offset, options.hit_limit);
+        log_info(R"(kept %d results starting at result #%d)", results.calculate_instances(), options.hit_offset + 1);
+    }
+}
 
-            return "unsupported";
-        };
+// write results to file_name in the format its extension asks for
+// throws std::invalid_argument if the file can't be created
+void write_results(const ScrapeResults &results, const std::string &file_name) {
 
-        log_err(R"(invalid %s id. Please provide a number.")", get_type_name(search_type).data());
-        print_usage();
-        return 1;
+    log_info(R"(writing results to %s...)", file_name.data());
+
+    std::optional<binary_format> format{};
+    if (string_ends_with(file_name, as_cbor)) {
+        format = binary_format::CBOR;
+    } else if (string_ends_with(file_name, as_msgpack)) {
+        format = binary_format::MSGPACK;
     }
 
-    const uint32_t id = static_cast<uint32_t>(std::stoul(id_str));
+    const bool as_binary = format || string_ends_with(file_name, as_ndjson);
+    std::ofstream file(file_name, as_binary ? std::ios_base::out | std::ios_base::binary : std::ios_base::out);
+
+    if (!file.is_open() || !file.good()) {
+        throw std::invalid_argument(R"(unable to create output file)");
+    }
+
+    if (format) {
+
+        log_info(R"(writing results as %s..)", (*format == binary_format::CBOR ? "cbor" : "msgpack"));
+
+        results.write_binary(file, *format);
+    } else if (string_ends_with(file_name, as_json)) {
+
+        log_info(R"(writing results as json..)");
+
+        results.write_json(file);
+    } else if (string_ends_with(file_name, as_ndjson)) {
+
+        log_info(R"(writing results as ndjson..)");
+
+        NdjsonSink sink(file);
+        results.send_to(sink);
+    } else {
+        file << results;
+        file.close();
+    }
+
+    log_ok(R"(results wrote successfully.)");
+}
+
+// run every query in queries, one '<-v|-s> <id> [output file]' per line, against a project loaded once
+// lines that are empty or start with '#' are skipped
+int run_batch(std::istream &queries, const output_options &options) {
+
+    uint32_t found = 0;
+    uint32_t not_found = 0;
+    uint32_t failed = 0;
 
     try {
-        // search variable ids
-        std::unique_ptr<RPGMakerScraper> scraper = nullptr;
-        if (search_type == search_type_variables) {
-            scraper = std::make_unique<RPGMakerScraper>(ScrapeMode::VARIABLES, id);
-        } else if (search_type == search_type_switches) {
-            scraper = std::make_unique<RPGMakerScraper>(ScrapeMode::SWITCHES, id);
+        const RPGMakerProject project{};
+
+        if (memory_usage::get().is_enabled()) {
+            project.report_memory();
         }
 
-        if (scraper != nullptr) {
-            scraper->scrape();
+        std::string line{};
+        for (uint32_t line_number = 1; std::getline(queries, line); ++line_number) {
+
+            std::istringstream line_stream(line);
+            const std::vector<std::string> args{std::istream_iterator<std::string>(line_stream), std::istream_iterator<std::string>()};
+
+            if (args.empty() || args[0].front() == '#') {
+                continue;
+            }
+
+            if (args.size() < 2 || args.size() > 3) {
+                log_err(R"(line %d: expected '<-v|-s> <id> [output file]')", line_number);
+                ++failed;
+                continue;
+            }
+
+            const auto query = parse_query(args[0], args[1]);
+            if (!query) {
+                log_err(R"(line %d: skipping invalid query)", line_number);
+                ++failed;
+                continue;
+            }
+
+            try {
+                const RPGMakerScraper scraper(project, query->first, query->second);
+
+                // the same as run_query, maps after the first limit + offset hits never matter
+                const size_t hit_limit = options.hit_limit && !options.count_only ? options.hit_offset + options.hit_limit : 0;
+                ScrapeResults results = scraper.scrape(task_scheduler::get_default(), hit_limit);
 
-            if (output_to_file) {
-                log_info(R"(writing results to %s...)", argv[3]);
-                const std::string file_name{argv[3]};
-                std::ofstream file(file_name, std::ios_base::out);
+                if (memory_usage::get().is_enabled()) {
+                    results.report_memory();
+                }
 
-                if (!file.is_open() || !file.good()) {
-                    throw std::invalid_argument(R"(unable to create output file)");
+                if (results.has_results()) {
+                    ++found;
+                } else {
+                    ++not_found;
                 }
 
-                if (string_ends_with(file_name, as_json)) {
+                const stats::scoped_phase phase(stats_phase::OUTPUT);
 
-                    log_info(R"(writing results as json..)");
+                arrange_results(results, options);
 
-                    if (scraper->output_json()) {
-                        file << *scraper->output_json();
-                    }
+                if (options.count_only) {
+                    results.print_counts();
+                } else if (args.size() == 3) {
+                    write_results(results, args[2]);
                 } else {
-                    file << scraper;
-                    file.close();
+                    results.print_results();
                 }
+            } catch (const std::exception &e) {
+                log_err(R"(line %d: exception caught: %s)", line_number, e.what());
+                ++failed;
+            }
+        }
+    } catch (const std::exception &e) {
+        log_err(R"(exception caught: %s)", e.what());
+        return EXIT_ERROR;
+    }
+
+    log_ok(R"(ran %d queries: %d found, %d not found, %d failed)", found + not_found + failed, found, not_found, failed);
+
+    if (failed) {
+        return EXIT_ERROR;
+    }
+
+    return not_found ? EXIT_NOT_FOUND : EXIT_FOUND;
+}
 
-                log_ok(R"(results wrote successfully.)");
+// scrape for a single query while the project is being loaded
+int run_query(ScrapeMode mode, uint32_t id, PipelineOptions pipeline_options, const output_options &options,
+              const std::optional<std::string> &file_name, const std::optional<std::string> &ndjson_path) {
+
+    const bool ndjson_to_stdout = ndjson_path && *ndjson_path == to_stdout;
+
+    try {
+        // stream every hit out as soon as it's found
+        std::ofstream ndjson_file{};
+        std::unique_ptr<NdjsonSink> ndjson_sink{};
+
+        if (ndjson_to_stdout) {
+            // keep stdout clean for whatever reads the records
+            logger::get().set_stream(std::cerr);
+            ndjson_sink = std::make_unique<NdjsonSink>(std::cout);
+        } else if (ndjson_path) {
+            ndjson_file.open(*ndjson_path, std::ios_base::out | std::ios_base::binary);
+
+            if (!ndjson_file.is_open() || !ndjson_file.good()) {
+                throw std::invalid_argument(R"(unable to create ndjson output file)");
             }
+
+            log_info(R"(streaming results to %s...)", ndjson_path->data());
+            ndjson_sink = std::make_unique<NdjsonSink>(ndjson_file);
+        }
+
+        // hits can only be streamed when every one of them is output in the order it's found
+        const bool stream_hits = !options.window_hits() && options.hit_order == HitOrder::MAP;
+        if (stream_hits) {
+            pipeline_options.sink = ndjson_sink.get();
         }
+
+        // sorting only happens within a map, so the maps after the first limit + offset hits never matter
+        if (options.hit_limit && !options.count_only) {
+            pipeline_options.hit_limit = options.hit_offset + options.hit_limit;
+        }
+
+        // search variable or switch ids while the project is being loaded
+        ScrapePipeline pipeline(mode, id, pipeline_options);
+        ScrapeResults results = pipeline.run();
+
+        // sized before any hit is dropped for output
+        if (memory_usage::get().is_enabled()) {
+            pipeline.get_project().report_memory();
+            results.report_memory();
+        }
+
+        const bool found = results.has_results();
+
+        const stats::scoped_phase phase(stats_phase::OUTPUT);
+
+        arrange_results(results, options);
+
+        if (options.count_only) {
+            results.print_counts();
+            return found ? EXIT_FOUND : EXIT_NOT_FOUND;
+        }
+
+        if (ndjson_sink && !stream_hits) {
+            results.send_to(*ndjson_sink);
+        }
+
+        if (!ndjson_to_stdout) {
+            results.print_results();
+        }
+
+        if (file_name) {
+            write_results(results, *file_name);
+        }
+
+        return found ? EXIT_FOUND : EXIT_NOT_FOUND;
     } catch (const std::exception &e) {
         log_err(R"(exception caught: %s)", e.what());
     }
 
-    log_nopre("\n");
-    log_ok(R"(press enter to close the program...)");
+    return EXIT_ERROR;
+}
+
+int main(int argc, const char *argv[]) {
+
+    constexpr size_t expected_minimum_args = 2;
+
+    constexpr const char *flag_low_memory = "--low-memory";
+    constexpr const char *flag_ndjson = "--ndjson";
+    constexpr const char *flag_log_level = "--log-level";
+    constexpr const char *flag_limit = "--limit";
+    constexpr const char *flag_offset = "--offset";
+    constexpr const char *flag_sort = "--sort";
+    constexpr const char *flag_count_only = "--count-only";
+    constexpr const char *flag_batch = "--batch";
+    constexpr const char *flag_stats = "--stats";
+    constexpr const char *flag_stats_json = "--stats-json";
+    constexpr const char *flag_memory = "--memory";
+    constexpr const char *flag_memory_json = "--memory-json";
+    constexpr const char *flag_trace = "--trace";
+    constexpr const char *flag_perf_counters = "--perf-counters";
+
+    // split the optional flags from the positional arguments
+    std::vector<std::string> args{};
+    PipelineOptions pipeline_options{};
+    output_options options{};
+    std::optional<std::string> ndjson_path{};
+    std::optional<std::string> batch_path{};
+    std::optional<std::string> stats_json_path{};
+    std::optional<std::string> memory_json_path{};
+    std::optional<std::string> trace_path{};
+    bool print_stats = false;
+    bool print_memory = false;
+    bool count_hardware = false;
+
+    // reads the number following a flag into value, false if there isn't one
+    const auto parse_count = [&](int &i, size_t &value) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        const std::string_view count{argv[++i]};
+        const auto [end, error] = std::from_chars(count.data(), count.data() + count.size(), value);
+        return error == std::errc{} && end == count.data() + count.size();
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{argv[i]};
+
+        if (arg == flag_low_memory) {
+            pipeline_options.retain_events = false;
+            continue;
+        }
+
+        if (arg == flag_log_level) {
+            const auto level = (i + 1 < argc) ? logger::parse_level(argv[++i]) : std::nullopt;
+            if (!level) {
+                print_usage();
+                return EXIT_ERROR;
+            }
+            logger::get().set_level(*level);
+            continue;
+        }
+
+        if (arg == flag_limit || arg == flag_offset) {
+            if (!parse_count(i, arg == flag_limit ? options.hit_limit : options.hit_offset)) {
+                print_usage();
+                return EXIT_ERROR;
+            }
+            continue;
+        }
+
+        if (arg == flag_sort) {
+            static const std::unordered_map<std::string, HitOrder> orders = {
+                {"map", HitOrder::MAP},
+                {"access", HitOrder::ACCESS},
+                {"event", HitOrder::EVENT},
+            };
+
+            const auto order = (i + 1 < argc) ? orders.find(argv[++i]) : orders.end();
+            if (order == orders.end()) {
+                print_usage();
+                return EXIT_ERROR;
+            }
+            options.hit_order = order->second;
+            continue;
+        }
+
+        if (arg == flag_count_only) {
+            options.count_only = true;
+            continue;
+        }
+
+        if (arg == flag_stats) {
+            print_stats = true;
+            continue;
+        }
+
+        if (arg == flag_memory) {
+            print_memory = true;
+            continue;
+        }
+
+        if (arg == flag_perf_counters) {
+            count_hardware = true;
+            continue;
+        }
+
+        if (arg == flag_memory_json || arg == flag_trace) {
+            if (i + 1 >= argc) {
+                print_usage();
+                return EXIT_ERROR;
+            }
+            (arg == flag_memory_json ? memory_json_path : trace_path) = argv[++i];
+            continue;
+        }
+
+        if (arg == flag_ndjson || arg == flag_batch || arg == flag_stats_json) {
+            if (i + 1 >= argc) {
+                print_usage();
+                return EXIT_ERROR;
+            }
+            (arg == flag_ndjson ? ndjson_path : arg == flag_batch ? batch_path : stats_json_path) = argv[++i];
+            continue;
+        }
+
+        args.push_back(arg);
+    }
+
+    // hardware counters are reported per phase, next to their times
+    // a run without them is still worth finishing, so failing to open them only warns
+    if (count_hardware && perf_counters::enable()) {
+        print_stats = true;
+    }
+
+    // phases are only timed when someone asked for them
+    if (print_stats || stats_json_path) {
+        stats::get().enable();
+    }
+
+    // the bytes the process holds are only counted when someone asked for them
+    if (print_memory || memory_json_path) {
+        memory_usage::get().enable();
+    }
+
+    // every span of the run is only recorded when someone asked for a trace
+    if (trace_path) {
+        tracer::get().enable();
+        tracer::get().name_thread("main");
+    }
+
+    // write a json report through write into path, or to stdout for '-'
+    const auto write_json_report = [](const std::string &path, const auto &write) {
+        if (path == to_stdout) {
+            write(std::cout);
+            std::cout.flush();
+            return;
+        }
+
+        std::ofstream report_file(path, std::ios_base::out | std::ios_base::binary);
+        if (!report_file.is_open() || !report_file.good()) {
+            log_err(R"(unable to create report file %s)", path.data());
+            return;
+        }
+
+        write(report_file);
+    };
+
+    // print or write everything that was counted during the run
+    const auto report_stats = [&]() {
+        if (print_stats) {
+            stats::get().print();
+        }
+
+        if (stats_json_path) {
+            write_json_report(*stats_json_path, [](std::ostream &os) { stats::get().write_json(os); });
+        }
+
+        if (print_memory) {
+            memory_usage::get().print();
+        }
+
+        if (memory_json_path) {
+            write_json_report(*memory_json_path, [](std::ostream &os) { memory_usage::get().write_json(os); });
+        }
+
+        if (trace_path) {
+            write_json_report(*trace_path, [](std::ostream &os) { tracer::get().write_json(os); });
+        }
+    };
+
+    // batches never wait for the console, they're meant to be scripted
+    if (batch_path) {
+        // every query of a batch runs against one fully loaded project, so --low-memory can't apply
+        if (!args.empty() || ndjson_path || !pipeline_options.retain_events) {
+            print_usage();
+            return EXIT_ERROR;
+        }
+
+        int result = EXIT_ERROR;
+
+        if (*batch_path == to_stdout) {
+            result = run_batch(std::cin, options);
+        } else {
+            std::ifstream batch_file(*batch_path);
+
+            if (batch_file.is_open()) {
+                result = run_batch(batch_file, options);
+            } else {
+                log_err(R"(unable to open batch file %s)", batch_path->data());
+            }
+        }
+
+        report_stats();
+
+        logger::get().flush();
+        return result;
+    }
+
+    // check the argument count
+    if (args.size() < expected_minimum_args) {
+        print_usage();
+        return EXIT_ERROR;
+    }
+
+    const auto query = parse_query(args[0], args[1]);
+    if (!query) {
+        print_usage();
+        return EXIT_ERROR;
+    }
+
+    std::optional<std::string> file_name{};
+    if (args.size() == 3) {
+        file_name = args[2];
+    }
+
+    // an .ndjson output file is written while scraping rather than afterwards
+    if (file_name && !ndjson_path && string_ends_with(*file_name, as_ndjson)) {
+        ndjson_path = std::move(file_name);
+        file_name = std::nullopt;
+    }
+
+    // counting doesn't output a single hit
+    if (options.count_only) {
+        file_name = std::nullopt;
+        ndjson_path = std::nullopt;
+    }
+
+    const int result = run_query(query->first, query->second, pipeline_options, options, file_name, ndjson_path);
+
+    report_stats();
+
+    // only hold the window open when someone is there to close it
+    if (logger::is_interactive()) {
+        log_nopre("\n");
+        log_ok(R"(press enter to close the program...)");
+        logger::get().flush();
+
+        std::cin.get();
+    }
 
-    std::cin.get();
-    return 0;
+    logger::get().flush();
+    return result;
 }
@@ -0,0 +1,233 @@
+#include "memory_usage.hpp"
+
+#include "json_writer.hpp"
+#include "logger.hpp"
+#include "output_renderer.hpp"
+
+#include <cstdlib>
+#include <new>
+#include <string_view>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <malloc.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <sys/resource.h>
+#else
+#include <malloc.h>
+#include <sys/resource.h>
+#endif
+
+using colors = logger::console_colors;
+
+static constexpr std::array<std::string_view, static_cast<size_t>(memory_structure::COUNT)> structure_names = {
+    "all_events",
+    "all_common_events",
+    "map_names",
+    "variable_names",
+    "switch_names",
+    "common_event_names",
+    "results",
+    "parser_scratch",
+};
+
+// counted by every allocation of a thread, never shared so a plain add is enough
+static thread_local uint64_t thread_allocation_count = 0;
+static thread_local uint64_t thread_allocation_bytes = 0;
+
+// counted by every allocation once tracking is enabled, in the sizes the allocator handed out
+static std::atomic<bool> tracking{false};
+static std::atomic<int64_t> live_bytes{0};
+static std::atomic<int64_t> peak_live_bytes{0};
+static std::atomic<uint64_t> total_allocations{0};
+static std::atomic<uint64_t> total_bytes{0};
+
+// an embedded scraper leaves the allocator of the process it's loaded into alone
+// only the structure estimates and the peak rss are reported then
+#ifndef SCRAPER_LIBRARY
+
+// the size the allocator actually handed out for memory
+static size_t allocation_size(void *memory) {
+#ifdef _WIN32
+    return _msize(memory);
+#elif defined(__APPLE__)
+    return malloc_size(memory);
+#else
+    return malloc_usable_size(memory);
+#endif
+}
+
+void *operator new(std::size_t size) {
+
+    void *memory = std::malloc(size ? size : 1);
+    if (!memory) {
+        throw std::bad_alloc();
+    }
+
+    ++thread_allocation_count;
+    thread_allocation_bytes += size;
+
+    if (tracking.load(std::memory_order_relaxed)) {
+        const auto bytes = static_cast<int64_t>(allocation_size(memory));
+        const int64_t live = live_bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+
+        total_allocations.fetch_add(1, std::memory_order_relaxed);
+        total_bytes.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+
+        int64_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+        while (live > peak && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+
+    return memory;
+}
+
+void *operator new[](std::size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void *memory) noexcept {
+
+    if (memory && tracking.load(std::memory_order_relaxed)) {
+        live_bytes.fetch_sub(static_cast<int64_t>(allocation_size(memory)), std::memory_order_relaxed);
+    }
+
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+    ::operator delete(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+    ::operator delete(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+    ::operator delete(memory);
+}
+
+#endif
+
+uint64_t memory_usage::thread_allocations() {
+    return thread_allocation_count;
+}
+
+uint64_t memory_usage::thread_allocated_bytes() {
+    return thread_allocation_bytes;
+}
+
+uint64_t memory_usage::peak_rss_bytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS memory{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &memory, sizeof(memory))) {
+        return 0;
+    }
+    return memory.PeakWorkingSetSize;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+void memory_usage::enable() {
+    enabled.store(true);
+    tracking.store(true);
+}
+
+void memory_usage::record(memory_structure which, uint64_t bytes) {
+
+    auto &largest = structures[static_cast<size_t>(which)];
+
+    uint64_t current = largest.load(std::memory_order_relaxed);
+    while (bytes > current && !largest.compare_exchange_weak(current, bytes, std::memory_order_relaxed)) {
+    }
+}
+
+// frees of memory allocated before tracking started can take the live bytes below 0
+static uint64_t clamped(const std::atomic<int64_t> &bytes) {
+    const int64_t value = bytes.load(std::memory_order_relaxed);
+    return value > 0 ? static_cast<uint64_t>(value) : 0;
+}
+
+// bytes as megabytes with 3 decimals, e.g. 12.345 MB
+static void append_mb(output_renderer &renderer, uint64_t bytes) {
+    renderer.append(format_literal("%d.%03d MB\n"), bytes / (1024 * 1024), bytes % (1024 * 1024) * 1000 / (1024 * 1024));
+}
+
+// name padded to the column the sizes start at
+static void append_name(output_renderer &renderer, std::string_view name) {
+    renderer.append(format_literal("%s"), name);
+    for (size_t pad = name.size(); pad < 28; ++pad) {
+        renderer.append_raw(" ");
+    }
+}
+
+void memory_usage::print() const {
+
+    output_renderer renderer(logger::get().colors_enabled(), 4 * 1024);
+
+    renderer.append_raw("=========================================\n");
+    renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("memory"));
+    renderer.append_raw(" (structures are estimated from their capacities, the largest one seen)\n");
+    renderer.append_raw("=========================================\n");
+
+    for (size_t i = 0; i < structure_names.size(); ++i) {
+        append_name(renderer, structure_names[i]);
+        append_mb(renderer, structures[i].load(std::memory_order_relaxed));
+    }
+
+    renderer.append_raw("-----------------------------------------\n");
+
+    append_name(renderer, "allocated_now");
+    append_mb(renderer, clamped(live_bytes));
+    append_name(renderer, "allocated_at_peak");
+    append_mb(renderer, clamped(peak_live_bytes));
+    append_name(renderer, "allocated_in_total");
+    append_mb(renderer, total_bytes.load(std::memory_order_relaxed));
+    append_name(renderer, "allocations");
+    renderer.append(format_literal("%d\n"), total_allocations.load(std::memory_order_relaxed));
+    append_name(renderer, "peak_rss");
+    append_mb(renderer, peak_rss_bytes());
+
+    renderer.append_raw("=========================================\n");
+
+    renderer.write_to_console();
+}
+
+void memory_usage::write_json(std::ostream &os) const {
+
+    json_writer writer(os);
+    writer.begin_object();
+
+    writer.key("allocator");
+    writer.begin_object();
+    writer.field("allocations", total_allocations.load(std::memory_order_relaxed));
+    writer.field("live_bytes", clamped(live_bytes));
+    writer.field("peak_live_bytes", clamped(peak_live_bytes));
+    writer.field("total_bytes", total_bytes.load(std::memory_order_relaxed));
+    writer.end_object();
+
+    writer.field("peak_rss_bytes", peak_rss_bytes());
+
+    writer.key("structures");
+    writer.begin_object();
+    for (size_t i = 0; i < structure_names.size(); ++i) {
+        writer.field(structure_names[i], structures[i].load(std::memory_order_relaxed));
+    }
+    writer.end_object();
+
+    writer.end_object();
+    writer.newline();
+}
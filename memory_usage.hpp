@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "utils.hpp"
+
+// the structures whose size is estimated, in the order they're reported
+enum class memory_structure : uint32_t {
+    ALL_EVENTS,
+    ALL_COMMON_EVENTS,
+    MAP_NAMES,
+    VARIABLE_NAMES,
+    SWITCH_NAMES,
+    COMMON_EVENT_NAMES,
+    RESULTS,
+    // the raw buffer and parsed json of the largest file
+    PARSER_SCRATCH,
+    COUNT,
+};
+
+// How much memory a run holds, printed with --memory.
+// Every allocation goes through a counting global operator new: the calling
+// thread's allocations are always counted since it's a plain add, the bytes
+// held by the whole process only once enable() was called.
+// On top of that the big structures report an estimate of their own size,
+// made up of their capacities and every string that doesn't fit inline.
+class memory_usage {
+public:
+    // never destroyed, memory is still freed while the program exits
+    static memory_usage &get() {
+        static memory_usage *instance = new memory_usage();
+        return *instance;
+    }
+
+    // how many allocations the calling thread made and the bytes it asked for, ever
+    static uint64_t thread_allocations();
+    static uint64_t thread_allocated_bytes();
+
+    // the most memory the process ever had resident, 0 if it can't be told
+    static uint64_t peak_rss_bytes();
+
+    // start counting the bytes held by the whole process
+    void enable();
+
+    __forceinline bool is_enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // remember the estimated size of a structure, the largest one seen is reported
+    void record(memory_structure which, uint64_t bytes);
+
+    // print every structure, the allocator totals and the peak rss to the console
+    void print() const;
+
+    // write the same as a single json object
+    void write_json(std::ostream &os) const;
+
+    // the bytes a string holds outside of itself, nothing if it fits inline
+    static size_t heap_bytes(const std::string &text) {
+        static const size_t inline_capacity = std::string().capacity();
+        return text.capacity() > inline_capacity ? text.capacity() + 1 : 0;
+    }
+
+    // the bytes a vector's buffer holds, without whatever its elements own
+    template<typename T>
+    static size_t heap_bytes(const std::vector<T> &values) {
+        return values.capacity() * sizeof(T);
+    }
+
+    // the bytes a deque's blocks hold, without whatever its elements own
+    template<typename T>
+    static size_t heap_bytes(const std::deque<T> &values) {
+        return values.size() * sizeof(T);
+    }
+
+    // the bytes every node of a map holds, including the tree's links
+    template<typename K, typename V>
+    static size_t heap_bytes(const std::map<K, V> &values) {
+        return values.size() * (sizeof(typename std::map<K, V>::value_type) + 4 * sizeof(void *));
+    }
+
+    // a map of names, the nodes and every name that doesn't fit inline
+    static size_t heap_bytes(const std::map<uint32_t, std::string> &names) {
+        size_t bytes = heap_bytes<uint32_t, std::string>(names);
+        for (const auto &[id, name] : names) {
+            bytes += heap_bytes(name);
+        }
+        return bytes;
+    }
+
+private:
+    memory_usage() = default;
+
+    std::atomic<bool> enabled{false};
+
+    std::array<std::atomic<uint64_t>, static_cast<size_t>(memory_structure::COUNT)> structures{};
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "logger.hpp"
+#include "utils.hpp"
+
+// Formats a whole report into a single growable buffer.
+// Colors are written as the same ANSI escape sequences the logger uses,
+// so the finished report can be handed to the console or a file in one write.
+class output_renderer {
+public:
+    using colors = logger::console_colors;
+
+    explicit output_renderer(bool _use_colors, size_t reserve = 64 * 1024) : use_colors(_use_colors) {
+        buffer.reserve(reserve);
+    }
+
+    // printf style formatting straight into the buffer, fmt is made with format_literal
+    template<typename format_t, typename ... arg>
+    void append(format_t fmt, const arg &... args) {
+        utils::format_to(buffer, fmt, args...);
+    }
+
+    void append_raw(std::string_view text) {
+        buffer.append(text);
+    }
+
+    void newline() {
+        buffer.push_back('\n');
+    }
+
+    // same as append, wrapped in the given colors
+    template<typename format_t, typename ... arg>
+    void append_colored(colors fg, colors bg, format_t fmt, const arg &... args) {
+
+        char color[16];
+        const auto color_escape = use_colors ? logger::format_color(fg, bg, color) : std::string_view{};
+
+        append_raw(color_escape);
+        append(fmt, args...);
+
+        if (!color_escape.empty()) {
+            append_raw(logger::color_reset);
+        }
+    }
+
+    __forceinline const std::string &get_buffer() const {
+        return buffer;
+    }
+
+    // hand the whole report to the console at once
+    void write_to_console() const {
+        logger::get().write_raw(buffer);
+    }
+
+private:
+    bool use_colors = true;
+    std::string buffer{};
+};
@@ -0,0 +1,136 @@
+#include "perf_counters.hpp"
+
+#include "logger.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+std::atomic<bool> perf_counters::enabled{false};
+
+bool perf_counters::difference(const sample &start, const sample &end, counts &counted) {
+
+    const uint64_t enabled_ns = end.time_enabled - start.time_enabled;
+    const uint64_t running_ns = end.time_running - start.time_running;
+
+    for (uint32_t i = 0; i < COUNT; ++i) {
+        const uint64_t value = end.values[i] - start.values[i];
+        // never counting at all leaves nothing to scale
+        counted[i] = running_ns == 0 || running_ns >= enabled_ns ? value :
+            static_cast<uint64_t>(static_cast<double>(value) * enabled_ns / running_ns);
+    }
+
+    return running_ns < enabled_ns;
+}
+
+#ifdef __linux__
+
+// the counters of a single thread, read together as one group
+struct thread_counters {
+    thread_counters() {
+        static constexpr uint64_t configs[perf_counters::COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES,
+            PERF_COUNT_HW_BRANCH_MISSES,
+        };
+
+        for (uint32_t i = 0; i < perf_counters::COUNT; ++i) {
+            perf_event_attr attributes{};
+            attributes.size = sizeof(attributes);
+            attributes.type = PERF_TYPE_HARDWARE;
+            attributes.config = configs[i];
+            // the group starts once every counter is in it
+            attributes.disabled = i == 0;
+            attributes.exclude_kernel = 1;
+            attributes.exclude_hv = 1;
+            // the times tell whether the group was multiplexed with other users of the counters
+            attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // this thread only, on whatever cpu it runs
+            fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, i == 0 ? -1 : fds[0], 0));
+            if (fds[i] < 0) {
+                error = errno;
+                return;
+            }
+        }
+
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        opened = true;
+    }
+
+    ~thread_counters() {
+        for (const int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    bool read(perf_counters::sample &values) const {
+        if (!opened) {
+            return false;
+        }
+
+        // the amount of counters, the time enabled, the time running, then each of their values
+        uint64_t group[perf_counters::COUNT + 3]{};
+        if (::read(fds[0], group, sizeof(group)) != static_cast<ssize_t>(sizeof(group))) {
+            return false;
+        }
+
+        values.time_enabled = group[1];
+        values.time_running = group[2];
+        for (uint32_t i = 0; i < perf_counters::COUNT; ++i) {
+            values.values[i] = group[i + 3];
+        }
+        return true;
+    }
+
+    int fds[perf_counters::COUNT] = {-1, -1, -1, -1};
+    bool opened = false;
+    int error = 0;
+};
+
+static thread_counters &local_counters() {
+    thread_local thread_counters counters{};
+    return counters;
+}
+
+bool perf_counters::enable() {
+
+    const auto &counters = local_counters();
+    if (!counters.opened) {
+        log_warn(R"(unable to open the hardware performance counters: %s)", std::strerror(counters.error));
+        if (counters.error == EACCES || counters.error == EPERM) {
+            log_warn(R"(lower /proc/sys/kernel/perf_event_paranoid or run with CAP_PERFMON to allow them)");
+        }
+        return false;
+    }
+
+    enabled.store(true);
+    return true;
+}
+
+bool perf_counters::read(sample &values) {
+    return local_counters().read(values);
+}
+
+#else
+
+bool perf_counters::enable() {
+    log_warn(R"(hardware performance counters are only supported on linux)");
+    return false;
+}
+
+bool perf_counters::read(sample &) {
+    return false;
+}
+
+#endif
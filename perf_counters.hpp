@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+#include "utils.hpp"
+
+// Hardware performance counters of the calling thread, read around every
+// timed phase with --perf-counters. Only linux has them, through perf_event_open;
+// everywhere else, or when the kernel doesn't allow it, enable() fails and
+// nothing is ever read.
+class perf_counters {
+public:
+    // the events counted, in the order they're read and reported
+    enum event : uint32_t {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        COUNT,
+    };
+
+    static constexpr std::array<std::string_view, COUNT> event_names = {
+        "cycles",
+        "instructions",
+        "cache_misses",
+        "branch_misses",
+    };
+
+    using counts = std::array<uint64_t, COUNT>;
+
+    // every counter at one point in time
+    // the kernel may multiplex the group with other users of the cpu's counters,
+    // it then only counted for time_running out of time_enabled
+    struct sample {
+        counts values{};
+        uint64_t time_enabled = 0;
+        uint64_t time_running = 0;
+    };
+
+    // open the counters of the calling thread to find out if they're supported at all
+    // returns false and logs why if they aren't, in which case they stay off
+    static bool enable();
+
+    __forceinline static bool is_enabled() {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // read every counter of the calling thread, opening them on its first read
+    // returns false if the thread's counters couldn't be opened
+    static bool read(sample &values);
+
+    // what was counted from start to end, scaled up to the whole time in between
+    // returns true if the counters were multiplexed meanwhile, the counts are only estimates then
+    static bool difference(const sample &start, const sample &end, counts &counted);
+
+private:
+    static std::atomic<bool> enabled;
+};
@@ -0,0 +1,43 @@
+#include "result_sink.hpp"
+
+#include "json_writer.hpp"
+
+void NdjsonSink::on_map_hits(uint32_t map_id, const EventMapResults &hits, const ActionFormatter &formatter) {
+
+    std::unique_lock<decltype(m)> lock(m);
+
+    json_writer writer(os);
+    std::string action_text{};
+
+    for (const auto &hit : hits) {
+        writer.begin_object();
+        writer.field("type", "map_event");
+        writer.field("map_id", map_id);
+        hit.write_fields(writer, formatter.format(action_text, hit.action));
+        writer.end_object();
+        writer.newline();
+    }
+
+    writer.flush();
+    os.flush();
+}
+
+void NdjsonSink::on_common_event_hits(uint32_t common_event_id, const ResultInformationBases &hits, const ActionFormatter &formatter) {
+
+    std::unique_lock<decltype(m)> lock(m);
+
+    json_writer writer(os);
+    std::string action_text{};
+
+    for (const auto &hit : hits) {
+        writer.begin_object();
+        writer.field("type", "common_event");
+        writer.field("common_event_id", common_event_id);
+        hit.write_fields(writer, formatter.format(action_text, hit.action));
+        writer.end_object();
+        writer.newline();
+    }
+
+    writer.flush();
+    os.flush();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+
+#include "rpgmaker_scraper.hpp"
+
+// Receives hits while a project is still being scraped, before the
+// final result set exists. Map hits and common event hits are handed over
+// from different threads, so implementations need to be thread-safe.
+// Hits only carry their structured action, formatter renders it if needed.
+class ResultSink {
+public:
+    virtual ~ResultSink() = default;
+
+    // every hit of a single map, called once per map with hits
+    virtual void on_map_hits(uint32_t map_id, const EventMapResults &hits, const ActionFormatter &formatter) = 0;
+
+    // every hit of a single common event, called once per common event with hits
+    virtual void on_common_event_hits(uint32_t common_event_id, const ResultInformationBases &hits, const ActionFormatter &formatter) = 0;
+};
+
+// Writes one json record per hit and line, flushing after every batch
+// so whatever reads the stream can start before the scrape is done.
+class NdjsonSink : public ResultSink {
+public:
+    explicit NdjsonSink(std::ostream &_os) : os(_os) {}
+
+    ~NdjsonSink() override = default;
+
+    void on_map_hits(uint32_t map_id, const EventMapResults &hits, const ActionFormatter &formatter) override;
+
+    void on_common_event_hits(uint32_t common_event_id, const ResultInformationBases &hits, const ActionFormatter &formatter) override;
+
+private:
+
+    std::mutex m;
+
+    std::ostream &os;
+};
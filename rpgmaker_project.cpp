@@ -0,0 +1,464 @@
+#include "rpgmaker_project.hpp"
+
+#include "logger.hpp"
+#include "memory_usage.hpp"
+#include "stats.hpp"
+#include "utils.hpp"
+
+#include <climits>
+#include <exception>
+#include <fstream>
+
+// lazy debug, set an id to UINT_MAX if you want to ignore it
+static constexpr bool is_debugging = false;
+static constexpr uint32_t debug_map_id = UINT_MAX;
+
+using colors = logger::console_colors;
+
+std::optional<std::string> RPGMakerProject::get_map_name(uint32_t id) const {
+
+    if (map_info_names.empty() || map_info_names.find(id) == map_info_names.end()) {
+        return std::nullopt;
+    }
+    return map_info_names.at(id);
+}
+
+std::optional<std::string> RPGMakerProject::get_variable_name(uint32_t id) const {
+
+    if (id == 0 || variable_names.empty() || variable_names.find(id) == variable_names.end()) {
+        return std::nullopt;
+    }
+
+    const std::string &name = variable_names.at(id);
+
+    if (name.empty()) {
+        return std::string("#") + std::to_string(id);
+    }
+
+    return name;
+}
+
+std::optional<std::string> RPGMakerProject::get_switch_name(uint32_t id) const {
+
+    if (switch_names.empty()) {
+        return std::nullopt;
+    }
+
+    if (switch_names.find(id) == switch_names.end()) {
+        return std::string("#") + std::to_string(id) + " ?";
+    }
+
+    const std::string &name = switch_names.at(id);
+
+    if (name.empty()) {
+        return std::string("#") + std::to_string(id);
+    }
+
+    return name;
+}
+
+std::optional<std::string> RPGMakerProject::get_common_event_name(uint32_t id) const {
+
+    if (id == 0 || common_event_names.empty() || common_event_names.find(id) == common_event_names.end()) {
+        return std::nullopt;
+    }
+
+    return common_event_names.at(id);
+}
+
+std::string RPGMakerProject::format_map_name(uint32_t id) {
+
+    return utils::format(format_literal("Map%03d.json"), id);
+}
+
+void RPGMakerProject::report_memory() const {
+
+    auto &memory = memory_usage::get();
+
+    size_t event_bytes = memory_usage::heap_bytes(all_events);
+    for (const auto &[map_id, events] : all_events) {
+        event_bytes += events.heap_bytes();
+    }
+    memory.record(memory_structure::ALL_EVENTS, event_bytes);
+
+    size_t common_event_bytes = memory_usage::heap_bytes(all_common_events);
+    for (const auto &common_event : all_common_events) {
+        common_event_bytes += common_event.heap_bytes();
+    }
+    memory.record(memory_structure::ALL_COMMON_EVENTS, common_event_bytes);
+
+    memory.record(memory_structure::MAP_NAMES, memory_usage::heap_bytes(map_info_names));
+    memory.record(memory_structure::VARIABLE_NAMES, memory_usage::heap_bytes(variable_names));
+    memory.record(memory_structure::SWITCH_NAMES, memory_usage::heap_bytes(switch_names));
+    memory.record(memory_structure::COMMON_EVENT_NAMES, memory_usage::heap_bytes(common_event_names));
+}
+
+void RPGMakerProject::load(task_scheduler &scheduler) {
+
+    load_names();
+
+    // scrape all maps
+    log_info(R"(scraping maps...)");
+
+    scrape_maps(scheduler);
+
+    log_info(R"(scraping common events...)");
+
+    scrape_common_events(scheduler);
+
+    log_validation_summary();
+}
+
+void RPGMakerProject::load_names() {
+
+    log_info(R"(verifying we're in the proper path...)");
+
+    if (!setup_directory()) {
+        throw std::logic_error("invalid root directory");
+    }
+
+    log_info(R"(populating all the map names...)");
+
+    // grab all the map names for later use
+    if (!populate_map_names()) {
+        throw std::logic_error("unable to populate map names");
+    }
+
+    log_info(R"(populating all the names...)");
+
+    // grab all the variable and switch names for later use
+    if (!populate_names()) {
+        throw std::logic_error("unable to populate names");
+    }
+}
+
+std::vector<uint32_t> RPGMakerProject::collect_map_ids() const {
+
+    std::vector<uint32_t> map_ids{};
+    map_ids.reserve(map_info_names.size());
+
+    for (const auto &[map_id, name] : map_info_names) {
+        // allow easy debugging
+        if (is_debugging && (debug_map_id != UINT_MAX && map_id != debug_map_id)) {
+            continue;
+        }
+
+        map_ids.push_back(map_id);
+    }
+
+    return map_ids;
+}
+
+void RPGMakerProject::scrape_maps(task_scheduler &scheduler) {
+
+    // every map gets its own slot, so tasks never touch a shared container
+    std::vector<std::pair<uint32_t, MapEvents>> parsed_maps{};
+
+    for (const auto map_id : collect_map_ids()) {
+        parsed_maps.emplace_back(map_id, MapEvents{});
+    }
+
+    task_group group(scheduler);
+
+    for (auto &[map_id, events] : parsed_maps) {
+        group.run([this, &group, map_id = map_id, events = &events]() {
+            scrape_map(group, map_id, *events);
+        });
+    }
+
+    group.wait();
+
+    for (auto &[map_id, events] : parsed_maps) {
+        if (!events.empty()) {
+            all_events[map_id] = std::move(events);
+        }
+    }
+}
+
+void RPGMakerProject::scrape_map(task_group &group, uint32_t map_id, MapEvents &events) const {
+
+    const tracer::scoped_span span("load_map", map_id);
+
+    const auto map_buffer = read_map_file(map_id);
+    if (!map_buffer) {
+        return;
+    }
+
+    const auto map_json = parse_map_file(map_id, *map_buffer);
+    if (!map_json) {
+        return;
+    }
+
+    build_map_events(map_json, events, &group);
+}
+
+std::optional<std::string> RPGMakerProject::read_map_file(uint32_t map_id) const {
+
+    const stats::scoped_phase phase(stats_phase::READ_MAPS, map_id);
+
+    // give hacky visual progress, it's as chatty as log_info
+#if LOG_COMPILE_LEVEL >= 4
+    if (logger::get().is_enabled(log_level::LOG_INFO)) {
+        utils::small_string<64> progress_status{};
+        utils::format_to(progress_status, format_literal(R"(scraping Map%03d...)"), map_id);
+
+        const size_t status_length = progress_status.size();
+        for (size_t i = 0; i < status_length; ++i) {
+            progress_status.push_back('\b');
+        }
+
+        log_colored_nnl(colors::WHITE, colors::BLACK, "%s", progress_status.view());
+    }
+#endif
+
+    // check if the current map we're scraping exists
+    std::filesystem::path map_file_path = root_data_path / format_map_name(map_id);
+    if (!std::filesystem::exists(map_file_path)) {
+        log_nopre("\n");
+        log_warn(R"(map id: %03d indicates there's supposed to be a file called: '%s' but it couldn't be found!)", map_id, map_file_path.string().data());
+        return std::nullopt;
+    }
+
+    // open the file
+    std::ifstream map_file(map_file_path, std::ios_base::in | std::ios_base::binary);
+    if (!map_file.is_open() || !map_file.good()) {
+        log_nopre("\n");
+        log_err(R"(unable to read '%s')", map_file_path.string().data());
+        return std::nullopt;
+    }
+
+    // read the whole thing in one go
+    std::string map_buffer{};
+    map_buffer.resize(static_cast<size_t>(std::filesystem::file_size(map_file_path)));
+    map_file.read(map_buffer.data(), static_cast<std::streamsize>(map_buffer.size()));
+    map_buffer.resize(static_cast<size_t>(map_file.gcount()));
+    map_file.close();
+
+    stats::add(stats_counter::BYTES_READ, map_buffer.size());
+
+    return map_buffer;
+}
+
+std::shared_ptr<const json> RPGMakerProject::parse_map_file(uint32_t map_id, std::string_view map_buffer) const {
+
+    const stats::scoped_phase phase(stats_phase::PARSE_MAPS, map_id);
+
+    const uint64_t allocated_before = memory_usage::thread_allocated_bytes();
+
+    // extract the json content
+    auto map_json = std::make_shared<json>(json::parse(map_buffer));
+    stats::add(stats_counter::FILES_PARSED);
+
+    // the raw file and everything its json allocated are alive at the same time
+    memory_usage::get().record(memory_structure::PARSER_SCRATCH,
+                               map_buffer.size() + memory_usage::thread_allocated_bytes() - allocated_before);
+
+    // verify that it contains 'events'
+    if (!map_json->contains("events")) {
+        log_nopre("\n");
+        log_warn(R"('%s' doesn't contain events!)", (root_data_path / format_map_name(map_id)).string().data());
+        return nullptr;
+    }
+
+    return map_json;
+}
+
+void RPGMakerProject::build_map_events(const std::shared_ptr<const json> &map_json, MapEvents &events, task_group *group) const {
+
+    const stats::scoped_phase phase(stats_phase::BUILD_EVENTS);
+
+    // big maps are split into ranges of this many events
+    constexpr size_t events_per_task = 64;
+
+    // find the events worth scraping
+    const auto &events_json = (*map_json)["events"];
+    const auto event_indices = std::make_shared<std::vector<size_t>>();
+    for (size_t i = 0, size = events_json.size(); i < size; ++i) {
+        const auto &event = events_json[i];
+        if (event.empty() || event.is_null()) {
+            continue;
+        }
+        event_indices->push_back(i);
+    }
+
+    events.layout(events_json, *event_indices);
+
+    const auto scrape_events = [map_json, event_indices, &events](size_t begin, size_t end) {
+        const auto &events_json = (*map_json)["events"];
+        for (size_t i = begin; i < end; ++i) {
+            events.build_event(i, events_json[(*event_indices)[i]]);
+        }
+    };
+
+    // scrape the events, splitting big maps up between the workers
+    if (group == nullptr || event_indices->size() <= events_per_task) {
+        scrape_events(0, event_indices->size());
+    } else {
+        parallel_for_chunks(*group, event_indices->size(), events_per_task, scrape_events);
+    }
+}
+
+bool RPGMakerProject::scrape_common_events(task_scheduler &scheduler) {
+
+    const stats::scoped_phase phase(stats_phase::LOAD_COMMON_EVENTS);
+
+    // common events are split into ranges of this many events
+    constexpr size_t common_events_per_task = 32;
+
+    constexpr const char *common_events_file_str = "CommonEvents.json";
+    const std::filesystem::path common_events_path = root_data_path / common_events_file_str;
+
+    if (!std::filesystem::exists(common_events_path)) {
+        log_err(R"(CommonEvents.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
+        return false;
+    }
+
+    std::ifstream common_events_file(common_events_path);
+    if (!common_events_file.is_open() || !common_events_file.good()) {
+        log_err(R"(Unable to open the CommonEvents file.)");
+        return false;
+    }
+
+    const uint64_t allocated_before = memory_usage::thread_allocated_bytes();
+
+    json common_events_json;
+    common_events_file >> common_events_json;
+    common_events_file.close();
+
+    memory_usage::get().record(memory_structure::PARSER_SCRATCH, memory_usage::thread_allocated_bytes() - allocated_before);
+
+    stats::add(stats_counter::BYTES_READ, std::filesystem::file_size(common_events_path));
+    stats::add(stats_counter::FILES_PARSED);
+
+    std::vector<size_t> common_event_indices{};
+    for (size_t i = 0, size = common_events_json.size(); i < size; ++i) {
+        if (common_events_json[i].empty()) {
+            continue;
+        }
+        common_event_indices.push_back(i);
+    }
+
+    all_common_events.resize(common_event_indices.size());
+
+    task_group group(scheduler);
+    parallel_for_chunks(group, common_event_indices.size(), common_events_per_task, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            all_common_events[i] = CommonEvent(common_events_json[common_event_indices[i]]);
+        }
+    });
+    group.wait();
+
+    // grab the common event names in one shot
+    for (const auto &common_event : all_common_events) {
+        common_event_names[common_event.id] = common_event.name;
+    }
+
+    return true;
+}
+
+bool RPGMakerProject::setup_directory() {
+
+    // check if the 'data/' folder exists.
+    if (!std::filesystem::exists(root_data_path)) {
+        log_err(R"('%s' doesn't exist. Please drop this executable in the root directory of your RPG Maker project.)", root_data_path.string().data());
+        return false;
+    }
+
+    return true;
+}
+
+bool RPGMakerProject::populate_map_names() {
+
+    const stats::scoped_phase phase(stats_phase::POPULATE_MAP_NAMES);
+
+    constexpr const char *map_infos_file_str = "MapInfos.json";
+    const std::filesystem::path map_infos_path = root_data_path / map_infos_file_str;
+
+    if (!std::filesystem::exists(map_infos_path)) {
+        log_err(R"(MapInfos.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
+        return false;
+    }
+
+    std::ifstream mapInfos_file(map_infos_path);
+    if (!mapInfos_file.is_open() || !mapInfos_file.good()) {
+        log_err(R"(Unable to open the mapinfos file.)");
+        return false;
+    }
+
+    json map_info_json;
+    mapInfos_file >> map_info_json;
+
+    stats::add(stats_counter::BYTES_READ, std::filesystem::file_size(map_infos_path));
+    stats::add(stats_counter::FILES_PARSED);
+
+    for (const auto &group : map_info_json) {
+        if (group.empty() ||
+            !group.contains("id") || !group["id"].is_number_integer() ||
+            !group.contains("name") || !group["name"].is_string()) {
+            continue;
+        }
+
+        const uint32_t map_id = group["id"].get<uint32_t>();
+        const std::string_view map_name = group["name"].get<std::string_view>();
+
+        map_info_names[map_id] = map_name;
+    }
+
+    mapInfos_file.close();
+
+    return true;
+}
+
+bool RPGMakerProject::populate_names() {
+
+    const stats::scoped_phase phase(stats_phase::POPULATE_NAMES);
+
+    constexpr const char *system_file_str = "System.json";
+    const std::filesystem::path system_file_path = root_data_path / system_file_str;
+
+    if (!std::filesystem::exists(system_file_path)) {
+        log_err(R"(System.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
+        return false;
+    }
+
+    std::ifstream system_file(system_file_path);
+    if (!system_file.is_open() || !system_file.good()) {
+        log_err(R"(Unable to open the System file.)");
+        return false;
+    }
+
+    json system_json;
+    system_file >> system_json;
+    system_file.close();
+
+    stats::add(stats_counter::BYTES_READ, std::filesystem::file_size(system_file_path));
+    stats::add(stats_counter::FILES_PARSED);
+
+    if (!system_json.contains("variables")) {
+        log_err(R"(System.json doesn't contain variables!")");
+        return false;
+    }
+
+    for (size_t var_id = 0, size = system_json["variables"].size(); var_id < size; ++var_id) {
+        const auto &variable = system_json["variables"][var_id];
+        if (variable.is_null()) {
+            continue;
+        }
+        variable_names[static_cast<uint32_t>(var_id)] = variable.get<std::string_view>();
+    }
+
+    if (!system_json.contains("switches")) {
+        log_err(R"(System.json doesn't contain switches!")");
+        return false;
+    }
+
+    for (size_t switch_id = 0, size = system_json["switches"].size(); switch_id < size; ++switch_id) {
+        const auto &_switch = system_json["switches"][switch_id];
+        if (_switch.is_null()) {
+            continue;
+        }
+        switch_names[static_cast<uint32_t>(switch_id)] = _switch.get<std::string_view>();
+    }
+
+    return true;
+}
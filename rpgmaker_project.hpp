@@ -0,0 +1,162 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "json.hpp"
+using json = nlohmann::json;
+
+#include "rpgmaker_types.hpp"
+using namespace RPGMaker;
+
+#include "task_scheduler.hpp"
+#include "utils.hpp"
+
+using MapIdToName = std::map<uint32_t, std::string>;
+using VariableIdToName = std::map<uint32_t, std::string>;
+using SwitchIdToName = std::map<uint32_t, std::string>;
+using CommonEventIdToName = std::map<uint32_t, std::string>;
+using EventMap = std::map<uint32_t, MapEvents>;
+
+// All the data of a RPG Maker project loaded once up front.
+// Nothing is modified after construction, so any amount of queries can
+// read from the same project at the same time without locking.
+class RPGMakerProject {
+public:
+    // loads the project found in the 'data/' folder of the working directory
+    // the maps and common events are parsed in parallel on the given scheduler
+    // throws several types of exceptions
+    RPGMakerProject(task_scheduler &scheduler = task_scheduler::get_default()) :
+        RPGMakerProject(std::filesystem::current_path(), scheduler) {}
+
+    // loads the project found in the 'data/' folder of project_folder
+    // throws several types of exceptions
+    explicit RPGMakerProject(const std::filesystem::path &project_folder,
+                             task_scheduler &scheduler = task_scheduler::get_default()) :
+        root_data_path(project_folder / "data") {
+        load(scheduler);
+    }
+
+    ~RPGMakerProject() = default;
+
+    RPGMakerProject(const RPGMakerProject &) = delete;
+    RPGMakerProject &operator=(const RPGMakerProject &) = delete;
+
+    __forceinline const MapIdToName &get_map_info_names() const {
+        return map_info_names;
+    }
+
+    __forceinline const VariableIdToName &get_variable_names() const {
+        return variable_names;
+    }
+
+    __forceinline const EventMap &get_all_events() const {
+        return all_events;
+    }
+
+    __forceinline const std::vector<CommonEvent> &get_all_common_events() const {
+        return all_common_events;
+    }
+
+    // returns the name of a map via it's id
+    std::optional<std::string> get_map_name(uint32_t id) const;
+
+    // returns the name of a variable via it's id
+    std::optional<std::string> get_variable_name(uint32_t id) const;
+
+    // returns the name of a switch via it's id
+    std::optional<std::string> get_switch_name(uint32_t id) const;
+
+    // returns the name of a common event via it's id
+    std::optional<std::string> get_common_event_name(uint32_t id) const;
+
+    // translate a map id into the name of the .json file associated
+    static std::string format_map_name(uint32_t id);
+
+    // hand the estimated size of the events, common events and names to memory_usage
+    void report_memory() const;
+
+private:
+    friend class ScrapePipeline;
+    // the microbenchmarks in bench/ drive the private loading and matching steps directly
+    friend class ScrapeBenchmarks;
+
+    // only loads the names and common events, the maps are handed over later
+    struct deferred_maps_t {};
+    RPGMakerProject(deferred_maps_t, const std::filesystem::path &project_folder) :
+        root_data_path(project_folder / "data") {}
+
+    // Path to the root folder we're searching
+    std::filesystem::path root_data_path;
+
+    // All the map names mapped via map id
+    MapIdToName map_info_names{};
+
+    // All the variable names mapped via variable id
+    VariableIdToName variable_names{};
+
+    // All the switch names mapped via switch id
+    SwitchIdToName switch_names{};
+
+    // All the common event names mapped via common event id
+    CommonEventIdToName common_event_names{};
+
+    // All the events already parsed via map id
+    EventMap all_events{};
+
+    // All the common events in the project
+    std::vector<CommonEvent> all_common_events{};
+
+    // loads all the necessary functions to setup and verify input
+    // throws several types of exceptions
+    void load(task_scheduler &scheduler);
+
+    // verifies the directory and loads the map, variable and switch names
+    // throws several types of exceptions
+    void load_names();
+
+    // the ids of every map that should be scraped, in order
+    std::vector<uint32_t> collect_map_ids() const;
+
+    // check if the root directory exists
+    // returns true if valid, otherwise false
+    bool setup_directory();
+
+    // populate all the map names into map_info_names
+    // returns true if successful, otherwise false
+    bool populate_map_names();
+
+    // populate all the variable names into variable_names
+    // populate all the switch names into switch_names
+    // returns true if successful, otherwise false
+    bool populate_names();
+
+    // scrape all the existing maps and their events into all_events
+    // every map file is its own task
+    void scrape_maps(task_scheduler &scheduler);
+
+    // scrape a single map file into events
+    // maps with a lot of events spawn extra tasks into group for ranges of events
+    void scrape_map(task_group &group, uint32_t map_id, MapEvents &events) const;
+
+    // read the raw content of a map file
+    // returns nothing if the file is missing or unreadable
+    std::optional<std::string> read_map_file(uint32_t map_id) const;
+
+    // parse the raw content of a map file
+    // returns nullptr if it doesn't contain any events
+    std::shared_ptr<const json> parse_map_file(uint32_t map_id, std::string_view map_buffer) const;
+
+    // build the events of a parsed map file
+    // if group is given, big maps are split into ranges of events between the workers
+    void build_map_events(const std::shared_ptr<const json> &map_json, MapEvents &events, task_group *group) const;
+
+    // scrape all the common events into all_common_events
+    // returns true if successful, otherwise false
+    bool scrape_common_events(task_scheduler &scheduler);
+};
@@ -1,22 +1,49 @@
 #include "rpgmaker_scraper.hpp"
 
+#include "json_writer.hpp"
 #include "logger.hpp"
+#include "memory_usage.hpp"
+#include "output_renderer.hpp"
+#include "result_sink.hpp"
+#include "stats.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <climits>
 #include <exception>
-#include <fstream>
 #include <iomanip>
+#include <mutex>
+#include <tuple>
 
 // lazy debug, set an id to UINT_MAX if you want to ignore it
 static constexpr bool is_debugging = false;
-static constexpr uint32_t debug_map_id = UINT_MAX;
 static constexpr uint32_t debug_event_id = UINT_MAX;
 
 using colors = logger::console_colors;
-using access_color = std::pair<std::string, colors>;
+using access_color = std::pair<std::string_view, colors>;
+
+// count a hit towards the matcher that found it
+static void count_hit(stats::block &counts, const HitAction &action) {
+
+    // indexed by ActionType, past NONE
+    static constexpr stats_counter hit_counters[] = {
+        stats_counter::HITS_EVENT_PAGE_CONDITION,
+        stats_counter::HITS_IF_STATEMENT,
+        stats_counter::HITS_CONTROL_VARIABLE,
+        stats_counter::HITS_CONTROL_SWITCH,
+        stats_counter::HITS_SCRIPT,
+        stats_counter::HITS_COMMON_EVENT_TRIGGER,
+    };
+
+    if (action.type != ActionType::NONE) {
+        counts.add(hit_counters[static_cast<size_t>(action.type) - 1]);
+    }
+}
 
 static access_color get_access_info(const AccessType &access_type) {
-    static std::unordered_map<AccessType, access_color> info = {
+    static const std::unordered_map<AccessType, access_color> info = {
         {AccessType::NONE, {"NONE", colors::GRAY}},
         {AccessType::READ, {"READ", colors::BLUE}},
         {AccessType::READWRITE, {"READWRITE", colors::MAGENTA}},
@@ -30,548 +57,294 @@ static access_color get_access_info(const AccessType &access_type) {
     return info.at(AccessType::NONE);
 }
 
-std::optional<std::string> RPGMakerScraper::get_map_name(uint32_t id) const {
-
-    if (map_info_names.empty() || map_info_names.find(id) == map_info_names.end()) {
-        return std::nullopt;
-    }
-    return map_info_names.at(id);
-}
-
-std::optional<std::string> RPGMakerScraper::get_variable_name(uint32_t id) const {
-
-    if (id == 0 || variable_names.empty() || variable_names.find(id) == variable_names.end()) {
-        return std::nullopt;
-    }
-
-    const std::string &name = variable_names.at(id);
-
-    if (name.empty()) {
-        return std::string("#") + std::to_string(id);
-    }
-
-    return name;
-}
-
-std::optional<std::string> RPGMakerScraper::get_switch_name(uint32_t id) const {
-
-    if (switch_names.empty()) {
-        return std::nullopt;
-    }
-
-    if (switch_names.find(id) == switch_names.end()) {
-        return std::string("#") + std::to_string(id) + " ?";
-    }
-
-    const std::string &name = switch_names.at(id);
-
-    if (name.empty()) {
-        return std::string("#") + std::to_string(id);
-    }
-
-    return name;
-}
-
-std::optional<std::string> RPGMakerScraper::get_common_event_name(uint32_t id) const {
-
-    if (id == 0 || common_event_names.empty() || common_event_names.find(id) == common_event_names.end()) {
-        return std::nullopt;
-    }
-
-    return common_event_names.at(id);
-}
-
-void RPGMakerScraper::load() {
-
-    log_info(R"(verifying we're in the proper path...)");
-
-    if (!setup_directory()) {
-        throw std::logic_error("invalid root directory");
-    }
-
-    log_info(R"(populating all the map names...)");
-
-    // grab all the map names for later use
-    if (!populate_map_names()) {
-        throw std::logic_error("unable to populate map names");
-    }
-
-    log_info(R"(populating all the names...)");
-
-    // grab all the variable or switch names for later use
-    if (!populate_names()) {
-        throw std::logic_error("unable to populate names");
-    }
+RPGMakerScraper::RPGMakerScraper(const RPGMakerProject &_project, ScrapeMode _mode, uint32_t _id) :
+    project(_project), mode(_mode), query_id(_id) {
 
     if (mode == ScrapeMode::VARIABLES) {
         log_info(R"(verifying variable id...)");
 
-        if (!get_variable_name(query_id)) {
+        if (!project.get_variable_name(query_id)) {
             log_err(R"(variable #%03d doesn't exist as a predefined variable in this game!)", query_id);
             throw std::invalid_argument("invalid variable id");
         }
 
         // setup variable name
-        variable_name = *get_variable_name(query_id);
+        query_name = *project.get_variable_name(query_id);
+        condition_valid_bits = Condition::variable_valid_bit;
     } else if (mode == ScrapeMode::SWITCHES) {
         log_info(R"(verifying switch id...)");
 
-        if (!get_switch_name(query_id)) {
+        if (!project.get_switch_name(query_id)) {
             log_err(R"(switch #%03d doesn't exist as a predefined switch in this game!)", query_id);
             throw std::invalid_argument("invalid switch id");
         }
 
-        // setup variable name
-        switch_name = *get_switch_name(query_id);
+        // setup switch name
+        query_name = *project.get_switch_name(query_id);
+        condition_valid_bits = Condition::switch1_valid_bit | Condition::switch2_valid_bit;
     }
-
-    // scrape all maps
-    log_info(R"(scraping maps...)");
-
-    scrape_maps();
-
-    log_info(R"(scraping common events...)");
-
-    scrape_common_events();
 }
 
-void RPGMakerScraper::scrape_maps() {
+ScrapeResults RPGMakerScraper::scrape(task_scheduler &scheduler, size_t hit_limit) const {
 
-    for (const auto &[map_id, name] : map_info_names) {
-        // allow easy debugging
-        if (is_debugging && (debug_map_id != UINT_MAX && map_id != debug_map_id)) {
-            continue;
-        }
+    const tracer::scoped_span span("scrape");
 
-        // give hacky visual progress
-        progress_status =
-            utils::format_string(R"(scraping Map%03d...)", map_id);
-        log_colored_nnl(colors::WHITE, colors::BLACK, "%s", progress_status.data());
+    // big maps are split into ranges of this many events
+    constexpr size_t events_per_task = 64;
 
-        log_colored_nnl(colors::WHITE, colors::BLACK, "%s",
-                        std::string(progress_status.length(), '\b').data());
+    // a range of events on a single map, scraped by one task
+    struct map_event_range {
+        uint32_t map_id{};
+        const MapEvents *events = nullptr;
+        size_t begin{};
+        size_t end{};
+        EventMapResults hits{};
+        bool done = false;
+    };
 
-        // check if the current map we're scraping exists
-        std::filesystem::path map_file_path = root_data_path / format_map_name(map_id);
-        if (!std::filesystem::exists(map_file_path)) {
-            log_nopre("\n");
-            log_warn(R"(map id: %03d indicates there's supposed to be a file called: '%s' but it couldn't be found!)", map_id, map_file_path.string().data());
-            continue;
+    std::vector<map_event_range> map_event_ranges{};
+    for (const auto &[map_id, map_events] : project.get_all_events()) {
+        const size_t event_count = map_events.events.size();
+        for (size_t begin = 0; begin < event_count; begin += events_per_task) {
+            map_event_ranges.push_back({map_id, &map_events, begin, std::min(event_count, begin + events_per_task)});
         }
+    }
 
-        // open the file
-        std::ifstream map_file(map_file_path);
-        if (!map_file.is_open() || !map_file.good()) {
-            log_nopre("\n");
-            log_err(R"(unable to read '%s')", map_file_path.string().data());
-            continue;
-        }
+    ScrapeResults scrape_results(project, mode, query_id, query_name);
 
-        // extract the json content
-        json map_json;
-        map_file >> map_json;
-        map_file.close();
+    // the ranges before leading_range are all done and hold leading_hits hits together
+    // once that's enough, every map after the last of them is skipped, the same as ScrapePipeline does
+    std::mutex leading_mutex;
+    size_t leading_range = 0;
+    size_t leading_hits = 0;
+    std::atomic<uint32_t> last_needed_map{UINT32_MAX};
 
-        // verify that it contains 'events'
-        if (!map_json.contains("events")) {
-            log_nopre("\n");
-            log_warn(R"('%s' doesn't contain events!)", map_file_path.string().data());
-            continue;
-        }
+    task_group group(scheduler);
 
-        // scrape the events
-        for (const auto &event : map_json["events"]) {
-            if (event.empty() || event.is_null()) {
-                continue;
+    for (auto &range : map_event_ranges) {
+        group.run([&, this]() {
+            if (range.map_id > last_needed_map.load(std::memory_order_relaxed)) {
+                return;
             }
 
-            all_events[map_id].emplace_back(RPGMaker::Event{event});
-        }
-    }
-}
+            scrape_map_events(*range.events, range.begin, range.end, range.hits);
 
-bool RPGMakerScraper::scrape_common_events() {
+            if (!hit_limit) {
+                return;
+            }
 
-    constexpr const char *common_events_file_str = "CommonEvents.json";
-    const std::filesystem::path common_events_path = root_data_path / common_events_file_str;
+            std::lock_guard<std::mutex> lock(leading_mutex);
+            range.done = true;
 
-    if (!std::filesystem::exists(common_events_path)) {
-        log_err(R"(CommonEvents.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
-        return false;
-    }
+            while (leading_range < map_event_ranges.size() && map_event_ranges[leading_range].done) {
+                leading_hits += map_event_ranges[leading_range++].hits.size();
+            }
 
-    std::ifstream common_events_file(common_events_path);
-    if (!common_events_file.is_open() || !common_events_file.good()) {
-        log_err(R"(Unable to open the CommonEvents file.)");
-        return false;
+            // the rest of a map's ranges still run, sorting needs every hit of it
+            if (leading_hits >= hit_limit && leading_range < map_event_ranges.size() && last_needed_map.load() == UINT32_MAX) {
+                const uint32_t map_id = map_event_ranges[leading_range - 1].map_id;
+                last_needed_map.store(map_id);
+                log_info(R"(found %d hits up to Map%03d, skipping the maps after it...)", leading_hits, map_id);
+            }
+        });
     }
 
-    json common_events_json;
-    common_events_file >> common_events_json;
-    common_events_file.close();
+    group.run([this, &scheduler, &scrape_results]() {
+        scrape_common_events(scheduler, scrape_results.common_event_results);
+    });
 
-    for (const auto &common_event : common_events_json) {
-        if (common_event.empty()) {
+    group.wait();
+
+    // stitch the map ranges back together in the original order
+    for (auto &range : map_event_ranges) {
+        if (range.hits.empty()) {
             continue;
         }
 
-        all_common_events.emplace_back(CommonEvent(common_event));
-
-        // grab the common event names in one shot
-        auto &back = all_common_events.back();
-        common_event_names[back.id] = back.name;
+        auto &hits = scrape_results.results[range.map_id];
+        hits.insert(hits.end(), std::make_move_iterator(range.hits.begin()), std::make_move_iterator(range.hits.end()));
     }
 
-    return true;
+    return scrape_results;
 }
 
-void RPGMakerScraper::scrape() {
+void RPGMakerScraper::scrape_common_events(task_scheduler &scheduler, CommonEventResultMap &common_event_results) const {
 
-    // go over every map
-    for (const auto &[map_id, events] : all_events) {
-        // go over every event
-        for (const auto &event : events) {
-            // allow easy debugging
-            if (is_debugging && (debug_event_id != UINT_MAX && event.id != debug_event_id)) {
-                continue;
-            }
-            // go over event page in each event
-            for (size_t page_num = 0, page_count = event.pages.size(); page_num < page_count; ++page_num) {
-                const auto &page = event.pages[page_num];
-
-                std::shared_ptr<MapEventResult> result_info = std::make_shared<MapEventResult>();
-                result_info->event_page = static_cast<uint32_t>(page_num) + 1;
-                result_info->event_info = event;
+    // common events are split into ranges of this many events
+    constexpr size_t common_events_per_task = 32;
 
-                auto downcasted_result_info = std::dynamic_pointer_cast<ResultInformationBase>(result_info);
+    const auto &all_common_events = project.get_all_common_events();
+    std::vector<CommonEventResultMap> common_event_chunks(
+        (all_common_events.size() + common_events_per_task - 1) / common_events_per_task);
 
-                if (scrape_event_page_condition(downcasted_result_info, page)) {
-                    results[map_id].push_back(result_info);
-                }
+    task_group group(scheduler);
+    parallel_for_chunks(group, all_common_events.size(), common_events_per_task, [&](size_t begin, size_t end) {
+        scrape_common_events(all_common_events, begin, end, common_event_chunks[begin / common_events_per_task]);
+    });
+    group.wait();
 
-                // now we'll take a look at each command and scrape accordingly
-                for (size_t line_num = 0, line_count = page.list.size(); line_num < line_count; ++line_num) {
-                    const auto &line = page.list[line_num];
-
-                    if (line.is_if_statement()) {
-                        if (scrape_command_if_statement(downcasted_result_info, line)) {
-                            result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                            results[map_id].push_back(result_info);
-                            continue;
-                        }
-                    }
-
-                    if (line.is_control_variable()) {
-                        if (scrape_command_control_variable(downcasted_result_info, line)) {
-                            result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                            results[map_id].push_back(result_info);
-                            continue;
-                        }
-                    }
-
-                    if (line.is_control_switch()) {
-                        if (scrape_command_control_switch(downcasted_result_info, line)) {
-                            result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                            results[map_id].push_back(result_info);
-                            continue;
-                        }
-                    }
-
-                    if (line.is_script()) {
-                        if (scrape_command_script(downcasted_result_info, line)) {
-                            result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                            results[map_id].push_back(result_info);
-                            continue;
-                        }
-                    }
-                }
-            }
+    // stitch everything back together in the original order
+    for (auto &chunk : common_event_chunks) {
+        for (auto &[common_event_id, chunk_results] : chunk) {
+            auto &results = common_event_results[common_event_id];
+            results.insert(results.end(), std::make_move_iterator(chunk_results.begin()), std::make_move_iterator(chunk_results.end()));
         }
     }
+}
+
+void RPGMakerScraper::scrape_map_events(const MapEvents &map_events, size_t begin, size_t end, EventMapResults &hits) const {
+
+    const stats::scoped_phase phase(stats_phase::MATCH_MAPS);
+    auto &counts = stats::local();
 
     const bool check_for_switches = mode == ScrapeMode::SWITCHES;
-    // go over every common event
-    for (const auto &common_event : all_common_events) {
 
-        // check for switches
-        if (check_for_switches && common_event.has_trigger()) {
-            auto result_info = std::make_shared<ResultInformationBase>();
+    // go over every event
+    for (size_t event_num = begin; event_num < end; ++event_num) {
+        const auto &event = map_events.events[event_num];
 
-            if (scrape_common_event_trigger(result_info, common_event)) {
-                result_info->name = common_event.name;
-                common_event_results[common_event.id].push_back(result_info);
-            }
+        // allow easy debugging
+        if (is_debugging && (debug_event_id != UINT_MAX && event.id != debug_event_id)) {
+            continue;
         }
 
-        auto &command_list = common_event.list;
-        for (size_t line_num = 0, line_count = command_list.size(); line_num < line_count; ++line_num) {
-            const auto &line = command_list[line_num];
+        counts.add(stats_counter::EVENTS_VISITED);
+        counts.add(stats_counter::PAGES_VISITED, event.page_count);
 
-            auto result_info = std::make_shared<ResultInformationBase>();
+        const EventDetails *event_details = &map_events.details[event_num];
 
-            if (line.is_if_statement()) {
-                if (scrape_command_if_statement(result_info, line)) {
-                    result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                    result_info->name = common_event.name;
-                    common_event_results[common_event.id].push_back(result_info);
-                    continue;
-                }
-            }
+        // go over event page in each event
+        for (uint32_t page_num = 0; page_num < event.page_count; ++page_num) {
+            const auto &page = map_events.get_page(event, page_num);
 
-            if (line.is_control_variable()) {
-                if (scrape_command_control_variable(result_info, line)) {
-                    result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                    result_info->name = common_event.name;
-                    common_event_results[common_event.id].push_back(result_info);
-                    continue;
-                }
-            }
+            if (page.conditions.references(query_id, check_for_switches)) {
+                MapEventResult result_info{};
+                result_info.event_page = page_num + 1;
+                result_info.event_info = event;
+                result_info.event_details = event_details;
 
-            if (line.is_control_switch()) {
-                if (scrape_command_control_switch(result_info, line)) {
-                    result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                    result_info->name = common_event.name;
-                    common_event_results[common_event.id].push_back(result_info);
-                    continue;
+                if (scrape_event_page_condition(result_info, page)) {
+                    count_hit(counts, result_info.action);
+                    hits.push_back(std::move(result_info));
                 }
             }
 
-            if (line.is_script()) {
-                if (scrape_command_script(result_info, line)) {
-                    result_info->line_number = static_cast<uint32_t>(line_num) + 1;
-                    result_info->name = common_event.name;
-                    common_event_results[common_event.id].push_back(result_info);
-                    continue;
-                }
+            // none of the commands can hold a hit, so they aren't even looked at
+            if (!page.summary.may_reference(query_id, check_for_switches)) {
+                counts.add(stats_counter::PAGES_SKIPPED);
+                counts.add(stats_counter::COMMANDS_SKIPPED, page.list.size());
+                continue;
             }
-        }
-    }
-
-    print_results();
-}
-
-bool RPGMakerScraper::setup_directory() {
 
-    // setup our working directory in the 'data' folder of the application
-    root_data_path = std::filesystem::current_path() / "data";
-
-    // check if the 'data/' folder exists.
-    if (!std::filesystem::exists(root_data_path)) {
-        log_err(R"('data/' folder doesn't exist. Please drop this executable in the root directory of your RPG Maker project.)");
-        return false;
-    }
-
-    return true;
-}
+            counts.add(stats_counter::COMMANDS_VISITED, page.list.size());
 
-bool RPGMakerScraper::populate_map_names() {
+            // now we'll take a look at each command and scrape accordingly
+            for (size_t line_num = 0, line_count = page.list.size(); line_num < line_count; ++line_num) {
+                counts.add_command(static_cast<uint32_t>(page.list[line_num].code));
 
-    constexpr const char *map_infos_file_str = "MapInfos.json";
-    const std::filesystem::path map_infos_path = root_data_path / map_infos_file_str;
+                MapEventResult line_result_info{};
+                line_result_info.event_page = page_num + 1;
+                line_result_info.event_info = event;
+                line_result_info.event_details = event_details;
 
-    if (!std::filesystem::exists(map_infos_path)) {
-        log_err(R"(MapInfos.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
-        return false;
-    }
-
-    std::ifstream mapInfos_file(map_infos_path);
-    if (!mapInfos_file.is_open() || !mapInfos_file.good()) {
-        log_err(R"(Unable to open the mapinfos file.)");
-        return false;
-    }
-
-    json map_info_json;
-    mapInfos_file >> map_info_json;
-
-    for (const auto &group : map_info_json) {
-        if (group.empty() ||
-            !group.contains("id") || !group["id"].is_number_integer() ||
-            !group.contains("name") || !group["name"].is_string()) {
-            continue;
+                if (scrape_command(line_result_info, page.list[line_num])) {
+                    line_result_info.line_number = static_cast<uint32_t>(line_num) + 1;
+                    count_hit(counts, line_result_info.action);
+                    hits.push_back(std::move(line_result_info));
+                }
+            }
         }
-
-        const uint32_t map_id = group["id"].get<uint32_t>();
-        const std::string_view map_name = group["name"].get<std::string_view>();
-
-        map_info_names[map_id] = map_name;
     }
-
-    mapInfos_file.close();
-
-    return true;
 }
 
-bool RPGMakerScraper::populate_names() {
+void RPGMakerScraper::scrape_common_events(const std::vector<CommonEvent> &common_events, size_t begin, size_t end, CommonEventResultMap &common_event_results) const {
 
-    constexpr const char *system_file_str = "System.json";
-    const std::filesystem::path system_file_path = root_data_path / system_file_str;
+    const stats::scoped_phase phase(stats_phase::MATCH_COMMON_EVENTS);
+    auto &counts = stats::local();
 
-    if (!std::filesystem::exists(system_file_path)) {
-        log_err(R"(System.json doesn't exist inside data/. Please make sure you're in the proper folder.)");
-        return false;
-    }
-
-    std::ifstream system_file(system_file_path);
-    if (!system_file.is_open() || !system_file.good()) {
-        log_err(R"(Unable to open the System file.)");
-        return false;
-    }
-
-    json system_json;
-    system_file >> system_json;
+    const bool check_for_switches = mode == ScrapeMode::SWITCHES;
+    // go over every common event
+    for (size_t common_event_num = begin; common_event_num < end; ++common_event_num) {
+        const auto &common_event = common_events[common_event_num];
 
-    if (mode == ScrapeMode::VARIABLES) {
-        if (!system_json.contains("variables")) {
-            log_err(R"(System.json doesn't contain variables!")");
-            system_file.close();
-            return false;
-        }
+        counts.add(stats_counter::COMMON_EVENTS_VISITED);
 
-        for (size_t var_id = 0, size = system_json["variables"].size(); var_id < size; ++var_id) {
-            const auto &variable = system_json["variables"][var_id];
-            if (variable.is_null()) {
-                continue;
-            }
-            variable_names[static_cast<uint32_t>(var_id)] = variable.get<std::string_view>();
-        }
-    } else if (mode == ScrapeMode::SWITCHES) {
-        if (!system_json.contains("switches")) {
-            log_err(R"(System.json doesn't contain switches!")");
-            system_file.close();
-            return false;
-        }
+        // check for switches
+        if (check_for_switches && common_event.has_trigger()) {
+            ResultInformationBase result_info{};
 
-        for (size_t switch_id = 0, size = system_json["switches"].size(); switch_id < size; ++switch_id) {
-            const auto &_switch = system_json["switches"][switch_id];
-            if (_switch.is_null()) {
-                continue;
+            if (scrape_common_event_trigger(result_info, common_event)) {
+                result_info.name = common_event.name;
+                count_hit(counts, result_info.action);
+                common_event_results[common_event.id].push_back(std::move(result_info));
             }
-            switch_names[static_cast<uint32_t>(switch_id)] = _switch.get<std::string_view>();
         }
-    }
-
-    system_file.close();
 
-    return true;
-}
-
-bool RPGMakerScraper::has_results() const {
-    return !results.empty() || !common_event_results.empty();
-}
-
-std::string RPGMakerScraper::format_map_name(uint32_t id) const {
+        auto &command_list = common_event.list;
+        counts.add(stats_counter::COMMANDS_VISITED, command_list.size());
 
-    return utils::format_string("Map%03d.json", id);
-}
+        for (size_t line_num = 0, line_count = command_list.size(); line_num < line_count; ++line_num) {
+            counts.add_command(static_cast<uint32_t>(command_list[line_num].code));
 
-std::string RPGMakerScraper::format_event_page_condition(const Condition &condition) {
+            ResultInformationBase result_info{};
 
-    if (mode == ScrapeMode::VARIABLES) {
-        return utils::format_string("IF {%s} >= %d:", variable_name.data(), condition.variable_value);
-    } else if (mode == ScrapeMode::SWITCHES) {
-        std::string ret = "IF ";
-        // this is messy af but this is the cleanest way to represent this
-        // rpgmaker allows statements when switch2 is only valid for some god awful reason..
-        if (condition.switch1_valid && condition.switch2_valid) {
-            ret += utils::format_string("{%s} && {%s}",
-                                        (condition.switch1_valid ? get_switch_name(condition.switch1_id)->data() :
-                                         get_switch_name(condition.switch2_id)->data()),
-                                        (condition.switch2_valid ? get_switch_name(condition.switch2_id)->data() :
-                                         get_switch_name(condition.switch1_id)->data()));
-        } else if (condition.switch1_valid) {
-            ret += utils::format_string("{%s}", get_switch_name(condition.switch1_id)->data());
-        } else if (condition.switch2_valid) {
-            ret += utils::format_string("{%s}", get_switch_name(condition.switch2_id)->data());
+            if (scrape_command(result_info, command_list[line_num])) {
+                result_info.line_number = static_cast<uint32_t>(line_num) + 1;
+                result_info.name = common_event.name;
+                count_hit(counts, result_info.action);
+                common_event_results[common_event.id].push_back(std::move(result_info));
+            }
         }
-        ret += ":";
-        return ret;
     }
-
-    return unsupported;
 }
 
-bool RPGMakerScraper::scrape_event_page_condition(std::shared_ptr<ResultInformationBase> result_info, const EventPage &event_page) {
+bool RPGMakerScraper::scrape_command(ResultInformationBase &result_info, const Command &command) const {
 
-    if (mode == ScrapeMode::VARIABLES) {
-        if (event_page.conditions.variable_id != query_id) {
-            return false;
-        }
-
-        // hacky check since RPGMaker's default id is '1'.
-        // so to prevent possible wrong results, we're going to ignore the ones that are 'off'
-        if (query_id == 1 && !event_page.conditions.variable_valid) {
-            return false;
-        }
-
-        result_info->active = event_page.conditions.variable_valid;
-
-    } else if (mode == ScrapeMode::SWITCHES) {
-        if (event_page.conditions.switch1_id != query_id &&
-            event_page.conditions.switch2_id != query_id) {
-            return false;
-        }
+    if (command.is_if_statement() && scrape_command_if_statement(result_info, command)) {
+        return true;
+    }
 
-        if (query_id == 1 &&
-            (!event_page.conditions.switch1_valid &&
-             !event_page.conditions.switch2_valid)) {
-            return false;
-        }
+    if (command.is_control_variable() && scrape_command_control_variable(result_info, command)) {
+        return true;
+    }
 
-        result_info->active = (event_page.conditions.switch1_valid || event_page.conditions.switch2_valid);
+    if (command.is_control_switch() && scrape_command_control_switch(result_info, command)) {
+        return true;
     }
 
-    result_info->access_type = AccessType::READ;
-    result_info->formatted_action = format_event_page_condition(event_page.conditions);
+    if (command.is_script() && scrape_command_script(result_info, command)) {
+        return true;
+    }
 
-    return true;
+    return false;
 }
 
-std::string RPGMakerScraper::format_command_if_statement(const std::vector<variable_element> &parameters) {
+bool RPGMakerScraper::scrape_event_page_condition(ResultInformationBase &result_info, const EventPage &event_page) const {
 
-    static const std::unordered_map<uint32_t, std::string> operator_strs = {
-        {0, "="},
-        {1, ">="},
-        {2, "<="},
-        {3, ">"},
-        {4, "<"},
-        {5, "!="},
-    };
+    const auto &conditions = event_page.conditions;
+    const bool active = conditions.valid & condition_valid_bits;
 
-    std::string if_statement = "If: ";
+    // hacky check since RPGMaker's default id is '1'.
+    // so to prevent possible wrong results, we're going to ignore the ones that are 'off'
+    if (query_id == 1 && !active) {
+        return false;
+    }
 
-    if (mode == ScrapeMode::VARIABLES) {
-        const bool being_compared_against =
-            (std::get<uint32_t>(parameters[2]) == static_cast<uint32_t>(IfStatement::IDType::VARIABLE) &&
-             std::get<uint32_t>(parameters[3]) == query_id);
+    result_info.active = active;
 
-        const auto oper = std::get<uint32_t>(parameters[4]);
+    result_info.access_type = AccessType::READ;
 
-        if (oper >= operator_strs.size()) {
-            log_warn("Operator was out of range!");
-            return "malformed operator";
-        }
+    auto &action = result_info.action;
+    action.type = ActionType::EVENT_PAGE_CONDITION;
+    action.first_id = conditions.switch1_id;
+    action.last_id = conditions.switch2_id;
+    action.operation = conditions.valid & (Condition::switch1_valid_bit | Condition::switch2_valid_bit);
+    action.value = conditions.variable_value;
 
-        if (!being_compared_against) {
-            if_statement +=
-                utils::format_string("{%s} %s %d:", get_variable_name(query_id)->data(),
-                                     operator_strs.at(oper).data(), std::get<uint32_t>(parameters[3]));
-        } else {
-            if_statement +=
-                utils::format_string("{#%d} %s {%s}:", std::get<uint32_t>(parameters[1]),
-                                     operator_strs.at(oper).data(), get_variable_name(query_id)->data());
-        }
-    } else if (mode == ScrapeMode::SWITCHES) {
-        const auto switch_compared = std::get<uint32_t>(parameters[1]);
-        if_statement +=
-            utils::format_string("{%s} is %s", get_switch_name(switch_compared)->data(),
-                                 (std::get<uint32_t>(parameters[2]) ? "OFF" : "ON"));
-
-    }
-
-    return if_statement;
+    return true;
 }
 
-bool RPGMakerScraper::scrape_command_if_statement(std::shared_ptr<ResultInformationBase> result_info, const Command &command) {
+bool RPGMakerScraper::scrape_command_if_statement(ResultInformationBase &result_info, const Command &command) const {
 
     constexpr uint32_t expected_variable_param_count = 5;
     constexpr uint32_t expected_switch_param_count = 3;
@@ -589,6 +362,8 @@ bool RPGMakerScraper::scrape_command_if_statement(std::shared_ptr<ResultInformat
         return determine_access_from_script(result_info, std::get<std::string>(command.parameters[1]));
     }
 
+    auto &action = result_info.action;
+
     // check if we're in the right mode
     if (mode == ScrapeMode::VARIABLES) {
         if (id_type != IfStatement::IDType::VARIABLE || param_count != expected_variable_param_count) {
@@ -606,6 +381,12 @@ bool RPGMakerScraper::scrape_command_if_statement(std::shared_ptr<ResultInformat
         if (compare_type == IfStatement::CompareType::VARIABLE && (id != query_id || compared_id != query_id)) {
             return false;
         }
+
+        action.first_id = id;
+        action.last_id = id;
+        action.operand = static_cast<uint32_t>(compare_type);
+        action.value = compared_id;
+        action.operation = std::get<uint32_t>(command.parameters[4]);
     } else if (mode == ScrapeMode::SWITCHES) {
         if (id_type != IfStatement::IDType::SWITCH || param_count != expected_switch_param_count) {
             return false;
@@ -616,16 +397,20 @@ bool RPGMakerScraper::scrape_command_if_statement(std::shared_ptr<ResultInformat
         if (id != query_id) {
             return false;
         }
+
+        action.first_id = id;
+        action.last_id = id;
+        action.value = std::get<uint32_t>(command.parameters[2]);
     }
 
-    result_info->access_type = AccessType::READ;
-    result_info->active = true;
-    result_info->formatted_action = format_command_if_statement(command.parameters);
+    result_info.access_type = AccessType::READ;
+    result_info.active = true;
+    action.type = ActionType::IF_STATEMENT;
 
     return true;
 }
 
-bool RPGMakerScraper::scrape_command_control_variable(std::shared_ptr<ResultInformationBase> result_info, const Command &command) {
+bool RPGMakerScraper::scrape_command_control_variable(ResultInformationBase &result_info, const Command &command) const {
     if (mode != ScrapeMode::VARIABLES) {
         return false;
     }
@@ -674,28 +459,38 @@ bool RPGMakerScraper::scrape_command_control_variable(std::shared_ptr<ResultInfo
         if ((!is_range && variable_id_start != query_id) || (is_range && !is_within_range)) {
             return false;
         }
-        result_info->access_type = AccessType::WRITE;
+        result_info.access_type = AccessType::WRITE;
     } else if (operand == ControlVariable::Operand::VARIABLE) {
         // if the thing we're setting another variable to is ours
         if (std::get<uint32_t>(command.parameters[4]) == query_id) {
             // support weird commands that are reading and writing the same variable(s)..
-            result_info->access_type = is_within_range ? AccessType::READWRITE : AccessType::READ;
+            result_info.access_type = is_within_range ? AccessType::READWRITE : AccessType::READ;
         } else if (is_within_range) {
             // if we're setting our variable to another variable in a range or not
-            result_info->access_type = AccessType::WRITE;
+            result_info.access_type = AccessType::WRITE;
         } else {
             // this doesn't deal with the query id at all
             return false;
         }
     }
 
-    result_info->active = true;
-    result_info->formatted_action = format_command_control_variable(command.parameters);
+    result_info.active = true;
+
+    auto &action = result_info.action;
+    action.type = ActionType::CONTROL_VARIABLE;
+    action.first_id = variable_id_start;
+    action.last_id = variable_id_end;
+    action.operation = std::get<uint32_t>(command.parameters[3]);
+    action.operand = static_cast<uint32_t>(operand);
+    action.value = std::get<uint32_t>(command.parameters[4]);
+    if (operand == ControlVariable::Operand::RANDOM) {
+        action.max_value = std::get<uint32_t>(command.parameters[5]);
+    }
 
     return true;
 }
 
-bool RPGMakerScraper::scrape_command_control_switch(std::shared_ptr<ResultInformationBase> result_info, const Command &command) {
+bool RPGMakerScraper::scrape_command_control_switch(ResultInformationBase &result_info, const Command &command) const {
     if (mode != ScrapeMode::SWITCHES) {
         return false;
     }
@@ -717,32 +512,181 @@ bool RPGMakerScraper::scrape_command_control_switch(std::shared_ptr<ResultInform
         return false;
     }
 
-    result_info->access_type = AccessType::WRITE;
-    result_info->active = true;
-    result_info->formatted_action = format_command_control_switch(command.parameters);
+    result_info.access_type = AccessType::WRITE;
+    result_info.active = true;
+
+    auto &action = result_info.action;
+    action.type = ActionType::CONTROL_SWITCH;
+    action.first_id = switch_id_start;
+    action.last_id = switch_id_end;
+    action.value = std::get<uint32_t>(command.parameters[2]);
+
+    return true;
+}
+
+bool RPGMakerScraper::scrape_command_script(ResultInformationBase &result_info, const Command &command) const {
+
+    constexpr uint32_t expected_param_count = 1;
+
+    if (command.parameters.size() != expected_param_count) {
+        return false;
+    }
+
+    if (!std::holds_alternative<std::string>(command.parameters[0])) {
+        return false;
+    }
+
+    return determine_access_from_script(result_info, std::get<std::string>(command.parameters[0]));
+}
+
+bool RPGMakerScraper::scrape_common_event_trigger(ResultInformationBase &result_info, const CommonEvent &common_event) const {
+
+    if (common_event.switch_id != query_id) {
+        return false;
+    }
+
+    result_info.access_type = AccessType::READ;
+    result_info.active = true;
+
+    auto &action = result_info.action;
+    action.type = ActionType::COMMON_EVENT_TRIGGER;
+    action.value = static_cast<uint32_t>(common_event.trigger);
 
     return true;
 }
 
-std::string RPGMakerScraper::format_command_control_switch(const std::vector<variable_element> &parameters) {
+bool RPGMakerScraper::determine_access_from_script(ResultInformationBase &result_info, std::string_view script_line) const {
+
+    stats::add(stats_counter::SCRIPT_LINES_SCANNED);
+
+    // the script is the only part of a hit that has to be copied,
+    // the events it came from might be freed before the results are printed
+    const auto set_script_action = [&result_info, script_line](AccessType access_type) {
+        result_info.access_type = access_type;
+        result_info.active = true;
+        result_info.action.type = ActionType::SCRIPT;
+        result_info.action.script = script_line;
+        return true;
+    };
+
+    if (mode == ScrapeMode::VARIABLES) {
+        utils::small_string<48> script_read_variable{};
+        utils::format_to(script_read_variable, format_literal("$gameVariables.value(%d)"), query_id);
+        if (script_line.find(script_read_variable.view()) != std::string::npos) {
+            return set_script_action(AccessType::READ);
+        }
+        utils::small_string<48> script_write_variable{};
+        utils::format_to(script_write_variable, format_literal("$gameVariables.setValue(%d"), query_id);
+        if (script_line.find(script_write_variable.view()) != std::string::npos) {
+            return set_script_action(AccessType::WRITE);
+        }
+    } else if (mode == ScrapeMode::SWITCHES) {
+        utils::small_string<48> script_read_switch{};
+        utils::format_to(script_read_switch, format_literal("$gameSwitches.value(%d)"), query_id);
+        if (script_line.find(script_read_switch.view()) != std::string::npos) {
+            return set_script_action(AccessType::READ);
+        }
+        utils::small_string<48> script_write_switch{};
+        utils::format_to(script_write_switch, format_literal("$gameSwitches.setValue(%d"), query_id);
+        if (script_line.find(script_write_switch.view()) != std::string::npos) {
+            return set_script_action(AccessType::WRITE);
+        }
+    }
 
-    const auto switch_id_start = std::get<uint32_t>(parameters[0]);
-    const auto switch_id_end = std::get<uint32_t>(parameters[1]);
+    return false;
+}
 
-    const auto is_range = switch_id_start != switch_id_end;
+void ActionFormatter::append_to(std::string &out, const HitAction &action) const {
+
+    switch (action.type) {
+        case ActionType::EVENT_PAGE_CONDITION:
+            append_event_page_condition(out, action);
+            break;
+        case ActionType::IF_STATEMENT:
+            append_command_if_statement(out, action);
+            break;
+        case ActionType::CONTROL_VARIABLE:
+            append_command_control_variable(out, action);
+            break;
+        case ActionType::CONTROL_SWITCH:
+            append_command_control_switch(out, action);
+            break;
+        case ActionType::SCRIPT:
+            out += action.script;
+            break;
+        case ActionType::COMMON_EVENT_TRIGGER:
+            append_common_event_trigger(out, action);
+            break;
+        default:
+            out += unsupported;
+            break;
+    }
+}
 
-    const auto setting_to_off = (std::get<uint32_t>(parameters[2]) ? true : false);
+void ActionFormatter::append_event_page_condition(std::string &out, const HitAction &action) const {
 
-    const auto var_prefix = is_range ?
-        utils::format_string("{%s} .. {%s}",
-                             get_switch_name(switch_id_start)->data(),
-                             get_switch_name(switch_id_end)->data()) :
-        utils::format_string("{%s}", get_switch_name(switch_id_start)->data());
+    if (mode == ScrapeMode::VARIABLES) {
+        utils::format_to(out, format_literal("IF {%s} >= %d:"), query_name, action.value);
+    } else if (mode == ScrapeMode::SWITCHES) {
+        const bool switch1_valid = action.operation & 1;
+        const bool switch2_valid = action.operation & 2;
 
-    return utils::format_string("%s = %s", var_prefix.data(), setting_to_off ? "OFF" : "ON");
+        out += "IF ";
+        // rpgmaker allows statements when switch2 is only valid for some god awful reason..
+        if (switch1_valid && switch2_valid) {
+            utils::format_to(out, format_literal("{%s} && {%s}"), project.get_switch_name(action.first_id)->data(),
+                             project.get_switch_name(action.last_id)->data());
+        } else if (switch1_valid) {
+            utils::format_to(out, format_literal("{%s}"), project.get_switch_name(action.first_id)->data());
+        } else if (switch2_valid) {
+            utils::format_to(out, format_literal("{%s}"), project.get_switch_name(action.last_id)->data());
+        }
+        out += ":";
+    } else {
+        out += unsupported;
+    }
 }
 
-std::string RPGMakerScraper::format_command_control_variable(const std::vector<variable_element> &parameters) {
+void ActionFormatter::append_command_if_statement(std::string &out, const HitAction &action) const {
+
+    static const std::unordered_map<uint32_t, std::string> operator_strs = {
+        {0, "="},
+        {1, ">="},
+        {2, "<="},
+        {3, ">"},
+        {4, "<"},
+        {5, "!="},
+    };
+
+    if (mode == ScrapeMode::VARIABLES) {
+        const bool being_compared_against =
+            (action.operand == static_cast<uint32_t>(IfStatement::IDType::VARIABLE) &&
+             action.value == query_id);
+
+        if (action.operation >= operator_strs.size()) {
+            log_warn("Operator was out of range!");
+            out += "malformed operator";
+            return;
+        }
+
+        out += "If: ";
+
+        if (!being_compared_against) {
+            utils::format_to(out, format_literal("{%s} %s %d:"), project.get_variable_name(query_id)->data(),
+                             operator_strs.at(action.operation), action.value);
+        } else {
+            utils::format_to(out, format_literal("{#%d} %s {%s}:"), action.first_id,
+                             operator_strs.at(action.operation), project.get_variable_name(query_id)->data());
+        }
+    } else if (mode == ScrapeMode::SWITCHES) {
+        utils::format_to(out, format_literal("If: {%s} is %s"), project.get_switch_name(action.first_id)->data(),
+                         (action.value ? "OFF" : "ON"));
+    } else {
+        out += "If: ";
+    }
+}
+
+void ActionFormatter::append_command_control_variable(std::string &out, const HitAction &action) const {
 
     static const std::unordered_map<uint32_t, std::string> operation_strs = {
         {0, "="},
@@ -753,116 +697,104 @@ std::string RPGMakerScraper::format_command_control_variable(const std::vector<v
         {5, "%="},
     };
 
-    const auto variable_id_start = std::get<uint32_t>(parameters[0]);
-    const auto variable_id_end = std::get<uint32_t>(parameters[1]);
-
-    const bool is_range = variable_id_start != variable_id_end;
-
-    const auto operation = std::get<uint32_t>(parameters[3]);
-    if (operation >= operation_strs.size()) {
+    if (action.operation >= operation_strs.size()) {
         log_warn("Operation was out of range!");
-        return "malformed operation";
+        out += "malformed operation";
+        return;
     }
 
-    const auto var_prefix = is_range ?
-        utils::format_string("{%s} .. {%s}",
-                             get_variable_name(variable_id_start)->data(),
-                             get_variable_name(variable_id_end)->data()) :
-        utils::format_string("{%s}", get_variable_name(variable_id_start)->data());
+    const auto operand = static_cast<ControlVariable::Operand>(action.operand);
+    if (operand != ControlVariable::Operand::VARIABLE &&
+        operand != ControlVariable::Operand::CONSTANT &&
+        operand != ControlVariable::Operand::RANDOM) {
+        out += unsupported;
+        return;
+    }
 
-    const auto operand = static_cast<ControlVariable::Operand>(std::get<uint32_t>(parameters[3]));
+    if (action.first_id != action.last_id) {
+        utils::format_to(out, format_literal("{%s} .. {%s}"), project.get_variable_name(action.first_id)->data(),
+                         project.get_variable_name(action.last_id)->data());
+    } else {
+        utils::format_to(out, format_literal("{%s}"), project.get_variable_name(action.first_id)->data());
+    }
 
     if (operand == ControlVariable::Operand::VARIABLE) {
-        const auto variable = std::get<uint32_t>(parameters[4]);
-
-        return utils::format_string("%s %s {%s}", var_prefix.data(),
-                                    operation_strs.at(operation).data(),
-                                    get_variable_name(variable)->data());
+        utils::format_to(out, format_literal(" %s {%s}"), operation_strs.at(action.operation),
+                         project.get_variable_name(action.value)->data());
     } else if (operand == ControlVariable::Operand::CONSTANT) {
-        const auto constant = std::get<uint32_t>(parameters[4]);
-
-        return utils::format_string("%s %s %d", var_prefix.data(),
-                                    operation_strs.at(operation).data(), constant);
-    } else if (operand == ControlVariable::Operand::RANDOM) {
-        const auto min = std::get<uint32_t>(parameters[4]);
-        const auto max = std::get<uint32_t>(parameters[5]);
-
-        return utils::format_string("%s = Random %d .. %d", var_prefix.data(), min, max);
+        utils::format_to(out, format_literal(" %s %d"), operation_strs.at(action.operation), action.value);
+    } else {
+        utils::format_to(out, format_literal(" = Random %d .. %d"), action.value, action.max_value);
     }
-
-    return unsupported;
 }
 
-bool RPGMakerScraper::scrape_command_script(std::shared_ptr<ResultInformationBase> result_info, const Command &command) {
-
-    constexpr uint32_t expected_param_count = 1;
+void ActionFormatter::append_command_control_switch(std::string &out, const HitAction &action) const {
 
-    if (command.parameters.size() != expected_param_count) {
-        return false;
+    if (action.first_id != action.last_id) {
+        utils::format_to(out, format_literal("{%s} .. {%s}"), project.get_switch_name(action.first_id)->data(),
+                         project.get_switch_name(action.last_id)->data());
+    } else {
+        utils::format_to(out, format_literal("{%s}"), project.get_switch_name(action.first_id)->data());
     }
 
-    if (!std::holds_alternative<std::string>(command.parameters[0])) {
-        return false;
-    }
+    utils::format_to(out, format_literal(" = %s"), action.value ? "OFF" : "ON");
+}
 
-    return determine_access_from_script(result_info, std::get<std::string>(command.parameters[0]));
+void ActionFormatter::append_common_event_trigger(std::string &out, const HitAction &action) const {
+    utils::format_to(out, format_literal("HAS TRIGGER: (%s)"),
+                     (static_cast<CommonEventTrigger>(action.value) == CommonEventTrigger::AUTORUN ? "AUTORUN" : "PARALLEL"));
 }
 
-std::string RPGMakerScraper::format_common_event_trigger(const CommonEvent &common_event) {
-    return utils::format_string("HAS TRIGGER: (%s)", (common_event.trigger == CommonEventTrigger::AUTORUN ? "AUTORUN" : "PARALLEL"));
+bool ScrapeResults::has_results() const {
+    return !results.empty() || !common_event_results.empty();
 }
 
-bool RPGMakerScraper::scrape_common_event_trigger(std::shared_ptr<ResultInformationBase> result_info, const CommonEvent &common_event) {
+void ScrapeResults::detach_events(EventMapResults &hits) {
 
-    if (common_event.switch_id != query_id) {
-        return false;
-    }
+    // hits of the same event come one after another
+    const EventDetails *source_details = nullptr;
+    const EventDetails *detached_details = nullptr;
 
-    result_info->access_type = AccessType::READ;
-    result_info->active = true;
-    result_info->formatted_action = format_common_event_trigger(common_event);
+    for (auto &hit : hits) {
+        if (hit.event_details != source_details) {
+            source_details = hit.event_details;
+            detached_details = &detached_event_details.emplace_back(*source_details);
+        }
 
-    return true;
+        hit.event_details = detached_details;
+    }
 }
 
-bool RPGMakerScraper::determine_access_from_script(std::shared_ptr<ResultInformationBase> result_info, std::string_view script_line) {
+void ScrapeResults::report_memory() const {
 
-    if (mode == ScrapeMode::VARIABLES) {
-        const std::string script_read_variable = utils::format_string("$gameVariables.value(%d)", query_id);
-        if (script_line.find(script_read_variable) != std::string::npos) {
-            result_info->access_type = AccessType::READ;
-            result_info->active = true;
-            result_info->formatted_action = script_line;
-            return true;
-        }
-        const std::string script_write_variable = utils::format_string("$gameVariables.setValue(%d", query_id);
-        if (script_line.find(script_write_variable) != std::string::npos) {
-            result_info->access_type = AccessType::WRITE;
-            result_info->active = true;
-            result_info->formatted_action = script_line;
-            return true;
-        }
-    } else if (mode == ScrapeMode::SWITCHES) {
-        const std::string script_read_switch = utils::format_string("$gameSwitches.value(%d)", query_id);
-        if (script_line.find(script_read_switch) != std::string::npos) {
-            result_info->access_type = AccessType::READ;
-            result_info->active = true;
-            result_info->formatted_action = script_line;
-            return true;
+    // what every hit owns itself, the event details they point at are counted with the events
+    const auto hit_bytes = [](const ResultInformationBase &hit) {
+        return memory_usage::heap_bytes(hit.name) + memory_usage::heap_bytes(hit.action.script);
+    };
+
+    size_t bytes = memory_usage::heap_bytes(results) + memory_usage::heap_bytes(common_event_results) +
+        memory_usage::heap_bytes(detached_event_details) + memory_usage::heap_bytes(query_name);
+
+    for (const auto &[map_id, hits] : results) {
+        bytes += memory_usage::heap_bytes(hits);
+        for (const auto &hit : hits) {
+            bytes += hit_bytes(hit);
         }
-        const std::string script_write_switch = utils::format_string("$gameSwitches.setValue(%d", query_id);
-        if (script_line.find(script_write_switch) != std::string::npos) {
-            result_info->access_type = AccessType::WRITE;
-            result_info->active = true;
-            result_info->formatted_action = script_line;
-            return true;
+    }
+    for (const auto &[common_event_id, hits] : common_event_results) {
+        bytes += memory_usage::heap_bytes(hits);
+        for (const auto &hit : hits) {
+            bytes += hit_bytes(hit);
         }
     }
+    for (const auto &details : detached_event_details) {
+        bytes += memory_usage::heap_bytes(details.name) + memory_usage::heap_bytes(details.note);
+    }
 
-    return false;
+    memory_usage::get().record(memory_structure::RESULTS, bytes);
 }
 
-uint32_t RPGMakerScraper::calculate_instances() const {
+uint32_t ScrapeResults::calculate_instances() const {
 
     uint32_t count = 0;
     for (const auto &pair : results) {
@@ -874,252 +806,373 @@ uint32_t RPGMakerScraper::calculate_instances() const {
     return count;
 }
 
-void RPGMakerScraper::print_results() {
+void ScrapeResults::render_summary(output_renderer &renderer) const {
 
-    if (!has_results()) {
-        log_colored(logger::console_colors::RED, logger::console_colors::BLACK, "Couldn't locate maps using RPGMaker Variable #%03d", query_id);
-        return;
-    }
+    const auto map_count = static_cast<uint32_t>(results.size());
+    const auto common_event_count = static_cast<uint32_t>(common_event_results.size());
+    const auto instances = calculate_instances();
 
-    log_nopre("=========================================");
+    renderer.append_raw("=========================================\n");
 
-    log_colored_nnl(colors::WHITE, colors::BLACK, "Found ");
-    log_colored_nnl(colors::GREEN, colors::BLACK, "%d %s", results.size(), (results.size() > 1 ? "maps" : "map"));
+    renderer.append_raw("Found ");
+    renderer.append_colored(colors::GREEN, colors::BLACK, format_literal("%d %s"), map_count, (map_count > 1 ? "maps" : "map"));
     if (!common_event_results.empty()) {
-        log_colored_nnl(colors::WHITE, colors::BLACK, " and ");
-        log_colored_nnl(colors::GREEN, colors::BLACK, "%d %s", common_event_results.size(), 
-                        (common_event_results.size() > 1 ? "common events" : "common event"));
+        renderer.append_raw(" and ");
+        renderer.append_colored(colors::GREEN, colors::BLACK, format_literal("%d %s"), common_event_count,
+                                (common_event_count > 1 ? "common events" : "common event"));
     }
-    log_colored_nnl(colors::WHITE, colors::BLACK, " yielding ");
-    log_colored(colors::GREEN, colors::BLACK, "%d total %s ", calculate_instances(), (calculate_instances() > 1 ? "instances" : "instance"));
+    renderer.append_raw(" yielding ");
+    renderer.append_colored(colors::GREEN, colors::BLACK, format_literal("%d total %s "), instances, (instances > 1 ? "instances" : "instance"));
+    renderer.newline();
 
     if (mode == ScrapeMode::VARIABLES) {
-        log_colored(colors::WHITE, colors::BLACK, "using variable #%03d (\'%s\')", query_id, variable_name.data());
+        renderer.append(format_literal("using variable #%03d (\'%s\')\n"), query_id, query_name.data());
     } else if (mode == ScrapeMode::SWITCHES) {
-        log_colored(colors::WHITE, colors::BLACK, "using switch #%03d (\'%s\')", query_id, switch_name.data());
+        renderer.append(format_literal("using switch #%03d (\'%s\')\n"), query_id, query_name.data());
     }
 
-    log_nopre("=========================================");
+    renderer.append_raw("=========================================\n");
+}
+
+void ScrapeResults::print_results() const {
+
+    // the whole report is rendered up front and handed to the console at once
+    output_renderer renderer(logger::get().colors_enabled());
+
+    if (!has_results()) {
+        renderer.append_colored(colors::RED, colors::BLACK, format_literal("Couldn't locate maps using RPGMaker Variable #%03d"), query_id);
+        renderer.newline();
+        renderer.write_to_console();
+        return;
+    }
+
+    render_summary(renderer);
+
+    // actions are only turned into text here, one at a time
+    const auto formatter = get_formatter();
+    std::string action_text{};
+
+    // group similar events cleanly
+    std::optional<uint32_t> latest_event_id{};
 
     for (const auto &[map_id, hits] : results) {
-        log_colored(colors::CYAN, colors::BLACK, "\n%s ('%s')", format_map_name(map_id).data(), get_map_name(map_id)->data());
-        log_colored(colors::WHITE, colors::BLACK, "--------------------------------------------------\n");
+        renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("\n%s ('%s')"), RPGMakerProject::format_map_name(map_id).data(), project->get_map_name(map_id)->data());
+        renderer.append_raw("\n--------------------------------------------------\n\n");
 
         for (const auto &hit : hits) {
-            const auto &event_info = hit->event_info;
-
-            // group similar events cleanly
-            static auto latest_event_id = event_info.id;
-            static auto latest_event_page = hit->event_page;
-
-            const bool is_different = (latest_event_id != event_info.id);
-            if (is_different) {
-                latest_event_id = event_info.id;
-                latest_event_page = hit->event_page;
-                if (hit != *hits.begin()) {
-                    log_nopre("\n");
-                }
+            const auto &event_info = hit.event_info;
+
+            if (latest_event_id && *latest_event_id != event_info.id && &hit != &hits.front()) {
+                renderer.append_raw("\n\n");
             }
+            latest_event_id = event_info.id;
 
-            log_colored_nnl((hit->active ? colors::DARK_GREEN : colors::DARK_GRAY), colors::BLACK, "%s",
-                            (hit->active ? "ON" : "OFF"));
-            const auto access_info = get_access_info(hit->access_type);
-            log_colored_nnl(access_info.second, colors::BLACK, " [%s]", access_info.first.data());
+            renderer.append_colored((hit.active ? colors::DARK_GREEN : colors::DARK_GRAY), colors::BLACK, format_literal("%s"),
+                                    (hit.active ? "ON" : "OFF"));
+            const auto access_info = get_access_info(hit.access_type);
+            renderer.append_colored(access_info.second, colors::BLACK, format_literal(" [%s]"), access_info.first.data());
 
-            log_nopre("\t@ [%d, %d] on Event #%03d ('%s') on Event Page #%02d:", event_info.x, event_info.y,
-                      event_info.id, event_info.name.data(), hit->event_page);
+            renderer.append(format_literal("\t@ [%d, %d] on Event #%03d ('%s') on Event Page #%02d:\n"), event_info.x, event_info.y,
+                            event_info.id, hit.event_details->name.data(), hit.event_page);
 
             // log line number | reference
-            if (hit->line_number) {
-                log_colored_nnl(colors::DARK_GRAY, colors::BLACK, "\t\t\tLine %03d", *hit->line_number);
+            if (hit.line_number) {
+                renderer.append_colored(colors::DARK_GRAY, colors::BLACK, format_literal("\t\t\tLine %03d"), *hit.line_number);
             } else {
-                log_colored_nnl(colors::DARK_GRAY, colors::BLACK, "\t\t\tLine N/A");
+                renderer.append_colored(colors::DARK_GRAY, colors::BLACK, format_literal("\t\t\tLine N/A"));
             }
 
-            log_colored(colors::WHITE, colors::BLACK, " | %s", hit->formatted_action.data());
+            renderer.append(format_literal(" | %s\n"), formatter.format(action_text, hit.action));
         }
     }
 
     if (!common_event_results.empty()) {
-        log_nopre("\n\n");
+        renderer.append_raw("\n\n\n");
     }
 
     for (const auto &[event_id, common_events] : common_event_results) {
-        log_colored(colors::CYAN, colors::BLACK, "\n%s", get_common_event_name(event_id)->data());
-        log_colored(colors::WHITE, colors::BLACK, "--------------------------------------------------\n");
+        renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("\n%s"), project->get_common_event_name(event_id)->data());
+        renderer.append_raw("\n--------------------------------------------------\n\n");
 
         for (const auto &common_event : common_events) {
 
-            // group similar common events evenly
-            static auto &latest_event_name = common_event->name;
-            const bool is_different = (latest_event_name != common_event->name);
-            if (is_different) {
-                latest_event_name = common_event->name;
-                if (common_event != *common_events.begin()) {
-                    log_nopre("\n");
-                }
-            }
-
-            log_colored_nnl((common_event->active ? colors::DARK_GREEN : colors::DARK_GRAY), colors::BLACK, "%s",
-                            (common_event->active ? "ON" : "OFF"));
-            const auto access_info = get_access_info(common_event->access_type);
-            log_colored_nnl(access_info.second, colors::BLACK, " [%s]", access_info.first.data());
+            renderer.append_colored((common_event.active ? colors::DARK_GREEN : colors::DARK_GRAY), colors::BLACK, format_literal("%s"),
+                                    (common_event.active ? "ON" : "OFF"));
+            const auto access_info = get_access_info(common_event.access_type);
+            renderer.append_colored(access_info.second, colors::BLACK, format_literal(" [%s]"), access_info.first.data());
 
             // log line number | reference
-            if (common_event->line_number) {
-                log_colored_nnl(colors::DARK_GRAY, colors::BLACK, "\t\tLine %03d", *common_event->line_number);
+            if (common_event.line_number) {
+                renderer.append_colored(colors::DARK_GRAY, colors::BLACK, format_literal("\t\tLine %03d"), *common_event.line_number);
             } else {
-                log_colored_nnl(colors::DARK_GRAY, colors::BLACK, "\t\tLine N/A");
+                renderer.append_colored(colors::DARK_GRAY, colors::BLACK, format_literal("\t\tLine N/A"));
             }
 
-            log_colored(colors::WHITE, colors::BLACK, " | %s", common_event->formatted_action.data());
+            renderer.append(format_literal(" | %s\n"), formatter.format(action_text, common_event.action));
         }
     }
 
-    log_nopre("\n=========================================");
+    renderer.append_raw("\n=========================================\n");
+
+    renderer.write_to_console();
+}
+
+void ScrapeResults::print_counts() const {
+
+    output_renderer renderer(logger::get().colors_enabled(), 1024);
+
+    if (!has_results()) {
+        renderer.append_colored(colors::RED, colors::BLACK, format_literal("Couldn't locate maps using RPGMaker Variable #%03d"), query_id);
+        renderer.newline();
+    } else {
+        render_summary(renderer);
+    }
+
+    renderer.write_to_console();
+}
+
+void ScrapeResults::sort_hits(HitOrder order) {
+
+    const auto by_access = [](const ResultInformationBase &a, const ResultInformationBase &b) {
+        return a.access_type < b.access_type;
+    };
+    const auto by_event = [](const MapEventResult &a, const MapEventResult &b) {
+        return std::tie(a.event_info.id, a.event_page) < std::tie(b.event_info.id, b.event_page);
+    };
+
+    if (order == HitOrder::ACCESS) {
+        for (auto &[map_id, hits] : results) {
+            std::stable_sort(hits.begin(), hits.end(), by_access);
+        }
+        for (auto &[common_event_id, hits] : common_event_results) {
+            std::stable_sort(hits.begin(), hits.end(), by_access);
+        }
+    } else if (order == HitOrder::EVENT) {
+        // common events are keyed by their id already
+        for (auto &[map_id, hits] : results) {
+            std::stable_sort(hits.begin(), hits.end(), by_event);
+        }
+    }
+}
+
+size_t ScrapeResults::limit_hits(size_t offset, size_t limit) {
+
+    size_t skipped = 0;
+    size_t kept = 0;
+    size_t dropped = 0;
+
+    // erase whatever falls outside the window from a single group of hits
+    const auto limit_group = [&](auto &hits) {
+        const size_t skip = std::min(offset - skipped, hits.size());
+        skipped += skip;
+
+        size_t keep = hits.size() - skip;
+        if (limit) {
+            keep = std::min(keep, limit - kept);
+        }
+        kept += keep;
+
+        dropped += hits.size() - keep;
+        hits.erase(hits.begin() + skip + keep, hits.end());
+        hits.erase(hits.begin(), hits.begin() + skip);
+    };
+
+    const auto limit_groups = [&](auto &groups) {
+        for (auto it = groups.begin(); it != groups.end();) {
+            limit_group(it->second);
+            it = it->second.empty() ? groups.erase(it) : std::next(it);
+        }
+    };
+
+    limit_groups(results);
+    limit_groups(common_event_results);
+
+    return dropped;
+}
+
+void ScrapeResults::send_to(ResultSink &sink) const {
+
+    const auto formatter = get_formatter();
+
+    for (const auto &[map_id, hits] : results) {
+        sink.on_map_hits(map_id, hits, formatter);
+    }
+    for (const auto &[common_event_id, hits] : common_event_results) {
+        sink.on_common_event_hits(common_event_id, hits, formatter);
+    }
 }
 
-std::ostream &operator<<(std::ostream &os, const RPGMakerScraper &scraper) {
+std::ostream &operator<<(std::ostream &os, const ScrapeResults &scrape_results) {
 
-    if (!scraper.has_results()) {
+    if (!scrape_results.has_results()) {
         return os;
     }
 
-    os << "=========================================" << "\n";
+    // same as print_results, rendered without colors and written in one go
+    output_renderer renderer(false);
+
+    const auto map_count = static_cast<uint32_t>(scrape_results.results.size());
+    const auto common_event_count = static_cast<uint32_t>(scrape_results.common_event_results.size());
+    const auto instances = scrape_results.calculate_instances();
+
+    renderer.append_raw("=========================================\n");
 
-    os << utils::format_string("Found %d %s ", scraper.results.size(), (scraper.results.size() > 1 ? "maps" : "map")).data();
-    
-    if (!scraper.common_event_results.empty()) {
-        os << utils::format_string(" and %d %s ", 
-                                   scraper.common_event_results.size(), 
-                                   (scraper.common_event_results.size() > 1 ? "common events" : "common event")).data();
+    renderer.append(format_literal("Found %d %s "), map_count, (map_count > 1 ? "maps" : "map"));
+
+    if (!scrape_results.common_event_results.empty()) {
+        renderer.append(format_literal(" and %d %s "), common_event_count, (common_event_count > 1 ? "common events" : "common event"));
     }
 
-    os << utils::format_string("yielding %d total %s ", scraper.calculate_instances(), (scraper.calculate_instances() > 1 ? "instances" : "instance")).data();
+    renderer.append(format_literal("yielding %d total %s "), instances, (instances > 1 ? "instances" : "instance"));
 
-    if (scraper.mode == ScrapeMode::VARIABLES) {
-        os << utils::format_string("using variable #%03d (\'%s\')", scraper.query_id, scraper.variable_name.data()).data();
-    } else if (scraper.mode == ScrapeMode::SWITCHES) {
-        os << utils::format_string("using switch #%03d (\'%s\')", scraper.query_id, scraper.switch_name.data()).data();
+    if (scrape_results.mode == ScrapeMode::VARIABLES) {
+        renderer.append(format_literal("using variable #%03d (\'%s\')"), scrape_results.query_id, scrape_results.query_name.data());
+    } else if (scrape_results.mode == ScrapeMode::SWITCHES) {
+        renderer.append(format_literal("using switch #%03d (\'%s\')"), scrape_results.query_id, scrape_results.query_name.data());
     }
 
-    os << std::endl << "=========================================" << std::endl;
+    renderer.append_raw("\n=========================================\n");
+
+    const auto formatter = scrape_results.get_formatter();
+    std::string action_text{};
+
+    // group similar events cleanly
+    std::optional<uint32_t> latest_event_id{};
+
+    for (const auto &[map_id, hits] : scrape_results.results) {
+        renderer.append(format_literal("\n%s (\'%s\')\n"), RPGMakerProject::format_map_name(map_id).data(), scrape_results.project->get_map_name(map_id)->data());
+        renderer.append_raw("--------------------------------------------------\n");
 
-    for (const auto &[map_id, hits] : scraper.results) {
-        os << "\n";
-        os << utils::format_string("%s (\'%s\')", scraper.format_map_name(map_id).data(), scraper.get_map_name(map_id)->data()) << "\n";
-        os << "--------------------------------------------------" << "\n";
         for (const auto &hit : hits) {
-            const auto &event_info = hit->event_info;
-
-            // group similar events cleanly
-            static auto latest_event_id = event_info.id;
-            if (latest_event_id != event_info.id) {
-                latest_event_id = event_info.id;
-                if (hit != *hits.begin()) {
-                    os << std::endl;
-                }
+            const auto &event_info = hit.event_info;
+
+            if (latest_event_id && *latest_event_id != event_info.id && &hit != &hits.front()) {
+                renderer.newline();
             }
+            latest_event_id = event_info.id;
 
-            const auto access_info = get_access_info(hit->access_type);
-            os << utils::format_string("%s", (hit->active ? "ON" : "OFF")).data() <<
-                utils::format_string(" [%s]", access_info.first.data()) << "\n";
+            const auto access_info = get_access_info(hit.access_type);
+            renderer.append(format_literal("%s [%s]\n"), (hit.active ? "ON" : "OFF"), access_info.first.data());
 
-            os << utils::format_string("\t@ [%d, %d] on Event #%03d (\'%s\') on Event Page #%02d:", event_info.x, event_info.y,
-                                       event_info.id, event_info.name.data(), hit->event_page) << "\n";
+            renderer.append(format_literal("\t@ [%d, %d] on Event #%03d (\'%s\') on Event Page #%02d:\n"), event_info.x, event_info.y,
+                            event_info.id, hit.event_details->name.data(), hit.event_page);
 
-            if (hit->line_number) {
-                os << utils::format_string("\t\tLine %03d | %s", *hit->line_number, hit->formatted_action.data()) << "\n";
+            if (hit.line_number) {
+                renderer.append(format_literal("\t\tLine %03d | %s\n"), *hit.line_number, formatter.format(action_text, hit.action));
             } else {
-                os << "\t\t" << hit->formatted_action.data() << "\n";
+                renderer.append(format_literal("\t\t%s\n"), formatter.format(action_text, hit.action));
             }
         }
     }
 
-    if (!scraper.common_event_results.empty()) {
-        os << "\n\n";
+    if (!scrape_results.common_event_results.empty()) {
+        renderer.append_raw("\n\n");
     }
 
-    for (const auto &[event_id, common_events] : scraper.common_event_results) {
-        os << scraper.get_common_event_name(event_id)->data() << "\n";
-        os << "--------------------------------------------------\n";
+    for (const auto &[event_id, common_events] : scrape_results.common_event_results) {
+        renderer.append(format_literal("%s\n"), scrape_results.project->get_common_event_name(event_id)->data());
+        renderer.append_raw("--------------------------------------------------\n");
 
         for (const auto &common_event : common_events) {
 
-            // group similar common events evenly
-            static auto &latest_event_name = common_event->name;
-            const bool is_different = (latest_event_name != common_event->name);
-            if (is_different) {
-                latest_event_name = common_event->name;
-                if (common_event != *common_events.begin()) {
-                    log_nopre("\n");
-                }
-            }
-
-            const auto access_info = get_access_info(common_event->access_type);
-            os << utils::format_string("%s", (common_event->active ? "ON" : "OFF")).data() <<
-                utils::format_string(" [%s]", access_info.first.data());
+            const auto access_info = get_access_info(common_event.access_type);
+            renderer.append(format_literal("%s [%s]"), (common_event.active ? "ON" : "OFF"), access_info.first.data());
 
             // log line number | reference
-            if (common_event->line_number) {
-                os << utils::format_string("\t\tLine %03d | %s", *common_event->line_number, common_event->formatted_action.data()) << "\n";
+            if (common_event.line_number) {
+                renderer.append(format_literal("\t\tLine %03d | %s\n"), *common_event.line_number, formatter.format(action_text, common_event.action));
             } else {
-                os << "\t\t" << common_event->formatted_action.data() << "\n";
+                renderer.append(format_literal("\t\t%s\n"), formatter.format(action_text, common_event.action));
             }
         }
     }
 
-    os << "=========================================" << "\n";
+    renderer.append_raw("=========================================\n");
+
+    const auto &buffer = renderer.get_buffer();
+    os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
 
     return os;
 }
 
-std::optional<std::string> RPGMakerScraper::output_json() {
-    if (!has_results()) {
-        return std::nullopt;
-    }
-
-    json _json;
-
-    // output map events under 'map_events'
-    for (const auto &[map_id, events] : results) {
-        for (const auto &event : events) {
-            json event_json = {
-                {"access_type", static_cast<uint32_t>(event->access_type)},
-                {"active", event->active},
-                {"event_page", event->event_page},
-                {"formatted_action", event->formatted_action},
-                {"id", event->event_info.id},
-                {"name", event->event_info.name},
-                {"note", event->event_info.note},
-                {"x", event->event_info.x},
-                {"y", event->event_info.y},
-            };
-
-            if (event->line_number) {
-                event_json["line_number"] = *event->line_number;
+template<typename writer_t>
+void ScrapeResults::write_structured(writer_t &writer) const {
+
+    const auto id_key = [](char (&buffer)[16], uint32_t id) {
+        const auto [end, error] = std::to_chars(std::begin(buffer), std::end(buffer), id);
+        return std::string_view(buffer, end - buffer);
+    };
+
+    char key_buffer[16];
+
+    const auto formatter = get_formatter();
+    std::string action_text{};
+
+    writer.begin_object(!common_event_results.empty() + !results.empty());
+
+    // output common event results under 'common_events'
+    if (!common_event_results.empty()) {
+        writer.key("common_events");
+        writer.begin_object(common_event_results.size());
+
+        for (const auto &[common_event_id, common_events] : common_event_results) {
+            writer.key(id_key(key_buffer, common_event_id));
+            writer.begin_array(common_events.size());
+
+            for (const auto &common_event : common_events) {
+                writer.begin_object(common_event.field_count());
+                common_event.write_fields(writer, formatter.format(action_text, common_event.action));
+                writer.end_object();
             }
 
-            _json["maps"][std::to_string(map_id)].push_back(event_json);
+            writer.end_array();
         }
+
+        writer.end_object();
     }
-    // output common event results under 'common_events'
-    for (const auto &[common_event_id, common_events] : common_event_results) {
-        for (const auto &common_event : common_events) {
-            json common_event_json = {
-                {"access_type", static_cast<uint32_t>(common_event->access_type)},
-                {"active", common_event->active},
-                {"formatted_action", common_event->formatted_action},
-                {"name", common_event->name}
-            };
-
-            if (common_event->line_number) {
-                common_event_json["line_number"] = *common_event->line_number;
+
+    // output map events under 'maps'
+    if (!results.empty()) {
+        writer.key("maps");
+        writer.begin_object(results.size());
+
+        for (const auto &[map_id, events] : results) {
+            writer.key(id_key(key_buffer, map_id));
+            writer.begin_array(events.size());
+
+            for (const auto &event : events) {
+                writer.begin_object(event.field_count());
+                event.write_fields(writer, formatter.format(action_text, event.action));
+                writer.end_object();
             }
 
-            _json["common_events"][std::to_string(common_event_id)].push_back(common_event_json);
+            writer.end_array();
         }
+
+        writer.end_object();
     }
 
-    return _json.dump();
+    writer.end_object();
+}
+
+bool ScrapeResults::write_json(std::ostream &os) const {
+    if (!has_results()) {
+        return false;
+    }
+
+    json_writer writer(os);
+    write_structured(writer);
+
+    return true;
+}
+
+bool ScrapeResults::write_binary(std::ostream &os, binary_format format) const {
+    if (!has_results()) {
+        return false;
+    }
+
+    binary_writer writer(os, format);
+    write_structured(writer);
+
+    return true;
 }
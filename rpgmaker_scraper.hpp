@@ -1,7 +1,6 @@
 #pragma once
 
-#include <filesystem>
-#include <list>
+#include <deque>
 #include <map>
 #include <optional>
 #include <ostream>
@@ -13,9 +12,16 @@
 #include "json.hpp"
 using json = nlohmann::json;
 
+#include "rpgmaker_project.hpp"
 #include "rpgmaker_types.hpp"
 using namespace RPGMaker;
 
+#include "binary_writer.hpp"
+#include "task_scheduler.hpp"
+
+class output_renderer;
+class ResultSink;
+
 enum class AccessType : uint32_t {
     NONE,
     READ,
@@ -28,6 +34,69 @@ enum class ScrapeMode : uint32_t {
     SWITCHES,
 };
 
+// How the hits of every map and common event are ordered,
+// maps and common events themselves always stay in id order
+enum class HitOrder : uint32_t {
+    // the order they appear in
+    MAP,
+    // grouped by access type
+    ACCESS,
+    // by event id, then event page
+    EVENT,
+};
+
+// What kind of command or condition a hit was found in
+enum class ActionType : uint32_t {
+    NONE,
+    EVENT_PAGE_CONDITION,
+    IF_STATEMENT,
+    CONTROL_VARIABLE,
+    CONTROL_SWITCH,
+    SCRIPT,
+    COMMON_EVENT_TRIGGER,
+};
+
+// Everything needed to describe a hit, kept as the raw ids and values it was found with.
+// Turned into text by ActionFormatter only once it's actually printed or serialized.
+struct HitAction {
+    ActionType type = ActionType::NONE;
+
+    // the first and last id the command affects, the same id if it isn't a range
+    // event page conditions: switch1_id and switch2_id
+    uint32_t first_id{};
+    uint32_t last_id{};
+
+    // the operator or operation the command was made with
+    // event page conditions: bit 0 is switch1_valid, bit 1 is switch2_valid
+    uint32_t operation{};
+
+    // what kind of value the command compares against or sets to
+    uint32_t operand{};
+
+    // the constant, id or minimum the command compares against or sets to
+    uint32_t value{};
+    // the maximum of a random range
+    uint32_t max_value{};
+
+    // the line of script itself, only copied for SCRIPT
+    std::string script{};
+
+    __forceinline bool operator==(const HitAction &other) const {
+        return (other.type == type &&
+                other.first_id == first_id &&
+                other.last_id == last_id &&
+                other.operation == operation &&
+                other.operand == operand &&
+                other.value == value &&
+                other.max_value == max_value &&
+                other.script == script);
+    }
+
+    __forceinline bool operator!=(const HitAction &other) const {
+        return !operator==(other);
+    }
+};
+
 // The base class to represent result information that can be found
 // in any event
 class ResultInformationBase {
@@ -44,7 +113,26 @@ public:
     // If this is a conditional in script, what line it appears on
     std::optional<uint32_t> line_number{};
     // information parsed from json describing where the variable is used
-    std::string formatted_action{};
+    HitAction action{};
+
+    // how many fields write_fields writes
+    __forceinline size_t field_count() const {
+        return line_number ? 5 : 4;
+    }
+
+    // write the members as object fields in alphabetical order
+    // through either a json_writer or a binary_writer
+    // formatted_action is the action as rendered by an ActionFormatter
+    template<typename writer_t>
+    void write_fields(writer_t &writer, std::string_view formatted_action) const {
+        writer.field("access_type", static_cast<uint32_t>(access_type));
+        writer.field("active", active);
+        writer.field("formatted_action", formatted_action);
+        if (line_number) {
+            writer.field("line_number", *line_number);
+        }
+        writer.field("name", name);
+    }
 };
 
 // Represent a result that is located in an event that's specifically found
@@ -54,203 +142,268 @@ public:
     MapEventResult() = default;
     ~MapEventResult() = default;
 
-    __forceinline bool operator==(const MapEventResult other) const {
+    __forceinline bool operator==(const MapEventResult &other) const {
 
         return (other.access_type == access_type &&
                 other.name == name &&
                 other.active == active &&
-                other.formatted_action == formatted_action &&
+                other.action == action &&
                 other.line_number == line_number);
     }
 
-    __forceinline bool operator!=(const MapEventResult other) const {
+    __forceinline bool operator!=(const MapEventResult &other) const {
         return !operator==(other);
     }
 
     // The event information it belongs to
     Event event_info{};
 
+    // The name and note of the event, owned by the project
+    const EventDetails *event_details = nullptr;
+
     // What event page this is present on
     uint32_t event_page{};
+
+    // how many fields write_fields writes
+    __forceinline size_t field_count() const {
+        return line_number ? 10 : 9;
+    }
+
+    // write the members along with the event's as object fields in alphabetical order
+    // through either a json_writer or a binary_writer
+    template<typename writer_t>
+    void write_fields(writer_t &writer, std::string_view formatted_action) const {
+        writer.field("access_type", static_cast<uint32_t>(access_type));
+        writer.field("active", active);
+        writer.field("event_page", event_page);
+        writer.field("formatted_action", formatted_action);
+        writer.field("id", event_info.id);
+        if (line_number) {
+            writer.field("line_number", *line_number);
+        }
+        writer.field("name", event_details->name);
+        writer.field("note", event_details->note);
+        writer.field("x", event_info.x);
+        writer.field("y", event_info.y);
+    }
 };
 
-using ResultInformationBases = std::vector<std::shared_ptr<ResultInformationBase>>;
-using EventMapResults = std::vector<std::shared_ptr<MapEventResult>>;
-using MapIdToName = std::map<uint32_t, std::string>;
-using VariableIdToName = std::map<uint32_t, std::string>;
-using SwitchIdToName = std::map<uint32_t, std::string>;
-using CommonEventIdToName = std::map<uint32_t, std::string>;
+using ResultInformationBases = std::vector<ResultInformationBase>;
+using EventMapResults = std::vector<MapEventResult>;
 using ResultMap = std::map<uint32_t, EventMapResults>;
 using CommonEventResultMap = std::map<uint32_t, ResultInformationBases>;
-using EventMap = std::map<uint32_t, std::vector<Event>>;
 
-class RPGMakerScraper {
+// Renders the action of a hit the way it's shown to users.
+// Only reads names from the project, so it still works after the events are freed.
+class ActionFormatter {
 public:
-    RPGMakerScraper() = default;
+    ActionFormatter(const RPGMakerProject &_project, ScrapeMode _mode, uint32_t _query_id, std::string_view _query_name) :
+        project(_project), mode(_mode), query_id(_query_id), query_name(_query_name) {}
 
-    RPGMakerScraper(ScrapeMode _mode, uint32_t _id) : query_id(_id), mode(_mode) { 
-        load(); 
+    // append the text of action to out
+    void append_to(std::string &out, const HitAction &action) const;
+
+    // replace the contents of out with the text of action, reusing its storage
+    __forceinline std::string_view format(std::string &out, const HitAction &action) const {
+        out.clear();
+        append_to(out, action);
+        return out;
     }
 
-    ~RPGMakerScraper() = default;
+private:
 
-    __forceinline MapIdToName get_map_info_names() const {
-        return map_info_names;
-    }
+    // constant strings
+    static constexpr const char *unsupported = "unsupported";
 
-    __forceinline VariableIdToName get_variable_names() const {
-        return variable_names;
-    }
+    const RPGMakerProject &project;
 
-    // returns the name of a map via it's id
-    std::optional<std::string> get_map_name(uint32_t id) const;
+    ScrapeMode mode{};
 
-    // returns the name of a variable via it's id
-    std::optional<std::string> get_variable_name(uint32_t id) const;
+    uint32_t query_id = 0;
 
-    // returns the name of a switch via it's id
-    std::optional<std::string> get_switch_name(uint32_t id) const;
+    std::string_view query_name{};
 
-    // returns the name of a common event via it's id
-    std::optional<std::string> get_common_event_name(uint32_t id) const;
+    // output the string showing the reference to a wanted id inside a
+    // RPGMaker event page condition
+    void append_event_page_condition(std::string &out, const HitAction &action) const;
 
-    // loads all the necessary functions to setup and verify input
-    // throws several types of exceptions
-    void load();
+    // output the string showing the reference to a wanted id inside a
+    // 'If Statement' command on an event page
+    void append_command_if_statement(std::string &out, const HitAction &action) const;
 
-    // scrape all information exclusive to RPGMaker variables into results
-    void scrape();
+    // output the string showing the reference to a wanted id inside a
+    // 'Control Variable' command on an event page
+    void append_command_control_variable(std::string &out, const HitAction &action) const;
 
-    // output the json dump of all results
-    std::optional<std::string> output_json();
+    // output the string showing the reference to a wanted id inside a
+    // 'Control Switch' command on an event page
+    void append_command_control_switch(std::string &out, const HitAction &action) const;
 
-    // overload operator for ostream to print information to a file
-    friend std::ostream &operator<<(std::ostream &os, const RPGMakerScraper &scraper);
+    // output the string showing the reference to a common event trigger
+    void append_common_event_trigger(std::string &out, const HitAction &action) const;
+};
 
-private:
+// The result set of a single query, owned by whoever ran it
+class ScrapeResults {
+public:
+    ScrapeResults(const RPGMakerProject &_project, ScrapeMode _mode, uint32_t _query_id, std::string _query_name) :
+        project(&_project), mode(_mode), query_id(_query_id), query_name(std::move(_query_name)) {}
 
-    // constant strings
-    static constexpr const char *unsupported = "unsupported";
+    ~ScrapeResults() = default;
 
-    // Path to the root folder we're searching
-    std::filesystem::path root_data_path;
+    // All of our map event results via map id
+    ResultMap results{};
 
-    // What mode the scraper is currently in
-    ScrapeMode mode{};
+    // All of our common event results via common event id
+    CommonEventResultMap common_event_results{};
+
+    // check if we have any results
+    bool has_results() const;
 
-    // All the map names mapped via map id
-    MapIdToName map_info_names{};
+    // calculates total of all results found
+    uint32_t calculate_instances() const;
+
+    // print all the found results in a pretty, colored and neat fashion
+    void print_results() const;
 
-    // All the variable names mapped via variable id
-    VariableIdToName variable_names{};
+    // print only how many results were found, nothing gets formatted
+    void print_counts() const;
 
-    // All the switch names mapped via switch id
-    SwitchIdToName switch_names{};
+    // reorder the hits of every map and common event, ties keep their order
+    void sort_hits(HitOrder order);
 
-    // All the common event names mapped via common event id
-    CommonEventIdToName common_event_names{};
+    // keep only the hits [offset, offset + limit) of the output order,
+    // maps come before common events. a limit of 0 keeps everything after offset
+    // returns the amount of hits that were dropped
+    size_t limit_hits(size_t offset, size_t limit);
 
-    // The ID we're interested in
+    // hand every result to sink at once, maps first
+    void send_to(ResultSink &sink) const;
+
+    // write all results as json straight to os, named keys are in alphabetical order
+    // while maps and common events are written in numeric id order (1, 2, 10), not the lexical order of their keys
+    // returns false without writing anything if there are no results
+    bool write_json(std::ostream &os) const;
+
+    // write all results as CBOR or MessagePack straight to os, laid out like write_json
+    // returns false without writing anything if there are no results
+    bool write_binary(std::ostream &os, binary_format format) const;
+
+    // overload operator for ostream to print information to a file
+    friend std::ostream &operator<<(std::ostream &os, const ScrapeResults &scrape_results);
+
+    // a formatter for the actions of these results, valid for as long as they are
+    __forceinline ActionFormatter get_formatter() const {
+        return ActionFormatter(*project, mode, query_id, query_name);
+    }
+
+    // hand the estimated size of every result to memory_usage
+    void report_memory() const;
+
+    // copy the details of the events hits point at into the results and repoint them
+    // lets the caller free the events afterwards
+    void detach_events(EventMapResults &hits);
+
+private:
+
+    // The project these results point into
+    const RPGMakerProject *project = nullptr;
+
+    // What mode the query was run in
+    ScrapeMode mode{};
+
+    // The ID that was queried
     uint32_t query_id = 0;
 
-    // The name of the variable we're interested in
-    std::string variable_name{};
+    // The name of the variable or switch that was queried
+    std::string query_name{};
 
-    // The name of the switch we're interested in
-    std::string switch_name{};
+    // render the 'Found ..' header shared by print_results and print_counts
+    void render_summary(output_renderer &renderer) const;
 
-    // All of our map event results via map id
-    ResultMap results{};
+    // walk every result record into a json_writer or binary_writer
+    template<typename writer_t>
+    void write_structured(writer_t &writer) const;
 
-    // All of our common event results via common event id
-    CommonEventResultMap common_event_results{};
+    // Event details owned by the results themselves after detach_events
+    std::deque<EventDetails> detached_event_details{};
+};
 
-    // All the events already parsed via map id
-    EventMap all_events{};
+// A lightweight query against an already loaded project.
+// It never modifies itself or the project, so many of these can run
+// at the same time on different threads.
+class RPGMakerScraper {
+public:
+    // verifies the id exists inside the project
+    // throws std::invalid_argument if it doesn't
+    RPGMakerScraper(const RPGMakerProject &_project, ScrapeMode _mode, uint32_t _id);
 
-    // All the common events in the project
-    std::vector<CommonEvent> all_common_events{};
+    ~RPGMakerScraper() = default;
 
-    // Progress status
-    std::string progress_status{};
+    // scrape all information exclusive to the queried id into a new result set
+    // maps, big maps' event ranges and common events are spread over the scheduler
+    // with a hit_limit, maps are skipped once the maps before them hold that many hits, 0 scrapes every map
+    ScrapeResults scrape(task_scheduler &scheduler = task_scheduler::get_default(), size_t hit_limit = 0) const;
 
-    // populate all the map names into map_info_names
-    // returns true if successful, otherwise false
-    bool populate_map_names();
+private:
+    friend class ScrapePipeline;
+    // the microbenchmarks in bench/ drive the private loading and matching steps directly
+    friend class ScrapeBenchmarks;
 
-    // populate all the variable names into variable_names
-    // populate all the switch names into switch_names
-    // returns true if successful, otherwise false
-    bool populate_names();
+    // The project we're searching
+    const RPGMakerProject &project;
 
-    // check if the root directory exists and setup root_data_path
-    // returns true if valid, otherwise false
-    bool setup_directory();
+    // What mode the scraper is currently in
+    ScrapeMode mode{};
 
-    // scrape all the existing maps and their events into all_events
-    void scrape_maps();
+    // The ID we're interested in
+    uint32_t query_id = 0;
 
-    // scrape all the common events into all_common_events
-    // returns true if successful, otherwise false
-    bool scrape_common_events();
+    // The name of the variable or switch we're interested in
+    std::string query_name{};
 
-    // check if we have any results
-    __forceinline bool has_results() const;
+    // the bits of Condition::valid that make a page condition on the query active
+    uint8_t condition_valid_bits = 0;
 
-    // translate a map id into the name of the .json file associated
-    __forceinline std::string format_map_name(uint32_t id) const;
+    // scrape the events in [begin, end) of a single map into hits
+    void scrape_map_events(const MapEvents &map_events, size_t begin, size_t end, EventMapResults &hits) const;
 
-    // output the string showing the reference to a wanted id inside a
-    // RPGMaker event page condition
-    std::string format_event_page_condition(const Condition &condition);
+    // scrape every common event into common_event_results, split in chunks over the scheduler
+    void scrape_common_events(task_scheduler &scheduler, CommonEventResultMap &common_event_results) const;
+
+    // scrape the common events in [begin, end) into common_event_results
+    void scrape_common_events(const std::vector<CommonEvent> &common_events, size_t begin, size_t end, CommonEventResultMap &common_event_results) const;
 
     // scrape RPGMaker event page conditions and modify result_info accordingly
+    // the caller checks that the conditions reference the query first, see Condition::references
     // returns true if valid, otherwise false
-    bool scrape_event_page_condition(std::shared_ptr<ResultInformationBase> result_info, const EventPage &event_page);
-
-    // output the string showing the reference to a wanted id inside a
-    // 'If Statement' command on an event page
-    std::string format_command_if_statement(const std::vector<variable_element> &parameters);
+    bool scrape_event_page_condition(ResultInformationBase &result_info, const EventPage &event_page) const;
 
     // scrape RPGMaker command 'If Statement' and modify result_info accordingly
     // returns true if valid, otherwise false
-    bool scrape_command_if_statement(std::shared_ptr<ResultInformationBase> result_info, const Command &command);
-
-    // output the string showing the reference to a wanted id inside a
-    // 'Control Variable' command on an event page
-    std::string format_command_control_variable(const std::vector<variable_element> &parameters);
+    bool scrape_command_if_statement(ResultInformationBase &result_info, const Command &command) const;
 
     // scrape RPGMaker command 'Control Variable' and modify result_info accordingly
     // returns true if valid, otherwise false
-    bool scrape_command_control_variable(std::shared_ptr<ResultInformationBase> result_info, const Command &command);
-
-    // output the string showing the reference to a wanted id inside a
-    // 'Control Switch' command on an event page
-    std::string format_command_control_switch(const std::vector<variable_element> &parameters);
+    bool scrape_command_control_variable(ResultInformationBase &result_info, const Command &command) const;
 
     // scrape RPGMaker command 'Control Switch' and modify result_info accordingly
     // returns true if valid, otherwise false
-    bool scrape_command_control_switch(std::shared_ptr<ResultInformationBase> result_info, const Command &command);
+    bool scrape_command_control_switch(ResultInformationBase &result_info, const Command &command) const;
 
     // scrape a line of 'script' and modify result_info accordingly
     // returns true if successful, otherwise false
-    bool scrape_command_script(std::shared_ptr<ResultInformationBase> result_info, const Command &command);
+    bool scrape_command_script(ResultInformationBase &result_info, const Command &command) const;
 
-    // output the string showing the reference to a common event trigger
-    std::string format_common_event_trigger(const CommonEvent &common_event);
+    // scrape a single command of any supported type and modify result_info accordingly
+    // returns true if successful, otherwise false
+    bool scrape_command(ResultInformationBase &result_info, const Command &command) const;
 
     // scrape a common event's 'trigger' and modify result_info accordingly
     // returns true if successful, otherwise false
-    bool scrape_common_event_trigger(std::shared_ptr<ResultInformationBase> result_info, const CommonEvent &common_event);
+    bool scrape_common_event_trigger(ResultInformationBase &result_info, const CommonEvent &common_event) const;
 
     // determines based on the found text inside the script line if it's read or write access
     // returns true if successful, otherwise false
-    bool determine_access_from_script(std::shared_ptr<ResultInformationBase> result_info, std::string_view script_line);
-
-    // calculates total of all results found
-    __forceinline uint32_t calculate_instances() const;
-
-    // print all the found results in a pretty, colored and neat fashion
-    // if file_output exists, the file is output with the same information without colors
-    void print_results();
-};
\ No newline at end of file
+    bool determine_access_from_script(ResultInformationBase &result_info, std::string_view script_line) const;
+};
@@ -1,16 +1,71 @@
 #include "rpgmaker_types.hpp"
 
 #include "logger.hpp"
+#include "memory_usage.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 
 using namespace RPGMaker;
 
+// how often each validation error was hit, shared by every loading thread
+static std::array<std::atomic<uint32_t>, static_cast<size_t>(ValidationError::COUNT)> validation_errors{};
+
+// what each validation error means, in ValidationError order
+static constexpr std::array<const char *, static_cast<size_t>(ValidationError::COUNT)> validation_error_descriptions = {
+    R"(Command doesn't have a code or it's not an integer!)",
+    R"(Command doesn't have parameters!)",
+    R"(This condition doesn't have a switch 1 id or it's not an integer!)",
+    R"(This condition doesn't have a bool to define if switch1Id is active or it's not a boolean!)",
+    R"(This condition doesn't have a switch 2 id or it's not an integer!)",
+    R"(This condition doesn't have a bool to define if switch2Id is active or it's not a boolean!)",
+    R"(This condition doesn't have a variable id or it's not an integer!)",
+    R"(This condition doesn't have a bool to define if variableId is active or it's not a boolean!)",
+    R"(This condition doesn't have a value to compare against or it's not an integer!)",
+    R"(This event page doesn't have conditions!)",
+    R"(This event page doesn't have commands!)",
+    R"(Event doesn't have a x position or it's not an integer!)",
+    R"(Event doesn't have a y position or it's not an integer!)",
+    R"(Event doesn't have a name or it's not a string!)",
+    R"(Event doesn't have a note or it's not a string!)",
+    R"(Event doesn't have an id or it's not an integer!)",
+    R"(Event doesn't have pages!)",
+    R"(CommonEvent doesn't have an id or it's not an integer!)",
+    R"(CommonEvent doesn't have a name or it's not a string!)",
+    R"(CommonEvent doesn't have a switch id or it's not an integer!)",
+    R"(CommonEvent doesn't have a trigger or it's not an integer!)",
+    R"(CommonEvent doesn't have commands!)",
+};
+
+void RPGMaker::report_validation_error(ValidationError error) {
+    validation_errors[static_cast<size_t>(error)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t RPGMaker::log_validation_summary() {
+
+    uint32_t total = 0;
+
+    for (size_t i = 0; i < validation_errors.size(); ++i) {
+        const uint32_t count = validation_errors[i].exchange(0, std::memory_order_relaxed);
+        if (count == 0) {
+            continue;
+        }
+
+        log_err(R"(%s (%u times))", validation_error_descriptions[i], count);
+        total += count;
+    }
+
+    return total;
+}
+
 bool Command::is_valid(const json &command_json) const {
     if (!command_json.contains("code") || !command_json["code"].is_number_integer()) {
-        log_err(R"(Command doesn't have a code or it's not an integer!")");
+        report_validation_error(ValidationError::COMMAND_CODE);
         return false;
     }
     if (!command_json.contains("parameters")) {
-        log_err(R"(Command doesn't have parameters!)");
+        report_validation_error(ValidationError::COMMAND_PARAMETERS);
         return false;
     }
 
@@ -51,33 +106,45 @@ Command::Command(const json &command_json) {
     }
 }
 
+size_t Command::heap_bytes() const {
+
+    size_t bytes = memory_usage::heap_bytes(parameters);
+    for (const auto &parameter : parameters) {
+        if (const auto *text = std::get_if<std::string>(&parameter)) {
+            bytes += memory_usage::heap_bytes(*text);
+        }
+    }
+
+    return bytes;
+}
+
 bool Condition::is_valid(const json &condition_json) const {
     if (!condition_json.contains("switch1Id") || !condition_json["switch1Id"].is_number_integer()) {
-        log_err(R"(This condition doesn't have a switch 1 id or it's not an integer!)");
+        report_validation_error(ValidationError::CONDITION_SWITCH1_ID);
         return false;
     }
     if (!condition_json.contains("switch1Valid") || !condition_json["switch1Valid"].is_boolean()) {
-        log_err(R"(This condition doesn't have a bool to define if switch1Id is active or it's not a boolean!)");
+        report_validation_error(ValidationError::CONDITION_SWITCH1_VALID);
         return false;
     }
     if (!condition_json.contains("switch2Id") || !condition_json["switch2Id"].is_number_integer()) {
-        log_err(R"(This condition doesn't have a switch 2 id or it's not an integer!)");
+        report_validation_error(ValidationError::CONDITION_SWITCH2_ID);
         return false;
     }
     if (!condition_json.contains("switch2Valid") || !condition_json["switch2Valid"].is_boolean()) {
-        log_err(R"(This condition doesn't have a bool to define if switch2Id is active or it's not a boolean!)");
+        report_validation_error(ValidationError::CONDITION_SWITCH2_VALID);
         return false;
     }
     if (!condition_json.contains("variableId") || !condition_json["variableId"].is_number_integer()) {
-        log_err(R"(This condition doesn't have a variable id or it's not an integer!)");
+        report_validation_error(ValidationError::CONDITION_VARIABLE_ID);
         return false;
     }
     if (!condition_json.contains("variableValid") || !condition_json["variableValid"].is_boolean()) {
-        log_err(R"(This condition doesn't have a bool to define if variableId is active or it's not a boolean!)");
+        report_validation_error(ValidationError::CONDITION_VARIABLE_VALID);
         return false;
     }
     if (!condition_json.contains("variableValue") || !condition_json["variableValue"].is_number_integer()) {
-        log_err(R"(This condition doesn't have a value to compare against or it's not an integer!)");
+        report_validation_error(ValidationError::CONDITION_VARIABLE_VALUE);
         return false;
     }
 
@@ -90,21 +157,132 @@ Condition::Condition(const json &condition_json) {
     }
 
     switch1_id = condition_json["switch1Id"].get<uint32_t>();
-    switch1_valid = condition_json["switch1Valid"].get<bool>();
     switch2_id = condition_json["switch2Id"].get<uint32_t>();
-    switch2_valid = condition_json["switch2Valid"].get<bool>();
     variable_id = condition_json["variableId"].get<uint32_t>();
-    variable_valid = condition_json["variableValid"].get<bool>();
     variable_value = condition_json["variableValue"].get<uint32_t>();
+
+    valid = (condition_json["switch1Valid"].get<bool>() ? switch1_valid_bit : 0) |
+        (condition_json["switch2Valid"].get<bool>() ? switch2_valid_bit : 0) |
+        (condition_json["variableValid"].get<bool>() ? variable_valid_bit : 0);
+}
+
+// the ids every command could be matched on, read with the same parameter counts and types as the matchers
+// anything they'd read differently or throw on is flagged, so its page keeps being walked
+PageSummary::PageSummary(const std::vector<Command> &list) {
+
+    const auto add_variable = [this](uint32_t id) {
+        min_variable_id = std::min(min_variable_id, id);
+        max_variable_id = std::max(max_variable_id, id);
+    };
+
+    const auto add_switch = [this](uint32_t id) {
+        min_switch_id = std::min(min_switch_id, id);
+        max_switch_id = std::max(max_switch_id, id);
+    };
+
+    // whether the parameters in [0, count) are all numbers
+    const auto has_numbers = [](const Command &command, size_t count) {
+        if (command.parameters.size() < count) {
+            return false;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            if (!std::holds_alternative<uint32_t>(command.parameters[i])) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (const auto &command : list) {
+        const auto &parameters = command.parameters;
+
+        if (command.is_if_statement()) {
+            flags |= has_if_statement;
+
+            if (!has_numbers(command, 1)) {
+                flags |= has_unexpected;
+                continue;
+            }
+
+            const auto id_type = static_cast<IfStatement::IDType>(std::get<uint32_t>(parameters[0]));
+            if (id_type == IfStatement::IDType::SCRIPT) {
+                flags |= has_script;
+            } else if (id_type == IfStatement::IDType::VARIABLE && parameters.size() == 5) {
+                // comparing against another variable only matches if the first one is the query too
+                if (!has_numbers(command, 5)) {
+                    flags |= has_unexpected;
+                    continue;
+                }
+                add_variable(std::get<uint32_t>(parameters[1]));
+            } else if (id_type == IfStatement::IDType::SWITCH && parameters.size() == 3) {
+                if (!has_numbers(command, 3)) {
+                    flags |= has_unexpected;
+                    continue;
+                }
+                add_switch(std::get<uint32_t>(parameters[1]));
+            }
+        } else if (command.is_control_switch()) {
+            flags |= has_control_switch;
+
+            if (parameters.size() != 3) {
+                continue;
+            }
+            if (!has_numbers(command, 3)) {
+                flags |= has_unexpected;
+                continue;
+            }
+            add_switch(std::get<uint32_t>(parameters[0]));
+            add_switch(std::get<uint32_t>(parameters[1]));
+        } else if (command.is_control_variable()) {
+            flags |= has_control_variable;
+
+            if (parameters.size() < 4 || !std::holds_alternative<uint32_t>(parameters[3])) {
+                flags |= has_unexpected;
+                continue;
+            }
+
+            const auto operand = static_cast<ControlVariable::Operand>(std::get<uint32_t>(parameters[3]));
+            switch (operand) {
+                case ControlVariable::Operand::SCRIPT:
+                    flags |= has_script;
+                    break;
+                case ControlVariable::Operand::GAME_DATA:
+                    break;
+                case ControlVariable::Operand::CONSTANT:
+                case ControlVariable::Operand::VARIABLE:
+                case ControlVariable::Operand::RANDOM: {
+                    const size_t expected_count = operand == ControlVariable::Operand::RANDOM ? 6 : 5;
+                    if (parameters.size() != expected_count) {
+                        break;
+                    }
+                    if (!has_numbers(command, expected_count)) {
+                        flags |= has_unexpected;
+                        break;
+                    }
+                    add_variable(std::get<uint32_t>(parameters[0]));
+                    add_variable(std::get<uint32_t>(parameters[1]));
+                    if (operand == ControlVariable::Operand::VARIABLE) {
+                        add_variable(std::get<uint32_t>(parameters[4]));
+                    }
+                    break;
+                }
+                default:
+                    flags |= has_unexpected;
+                    break;
+            }
+        } else if (command.is_script()) {
+            flags |= has_script;
+        }
+    }
 }
 
 bool EventPage::is_valid(const json &event_page_json) const {
     if (!event_page_json.contains("conditions")) {
-        log_err(R"(This event page doesn't have conditions!)");
+        report_validation_error(ValidationError::EVENT_PAGE_CONDITIONS);
         return false;
     }
     if (!event_page_json.contains("list")) {
-        log_err(R"(This event page doesn't have commands!)");
+        report_validation_error(ValidationError::EVENT_PAGE_LIST);
         return false;
     }
 
@@ -124,31 +302,43 @@ EventPage::EventPage(const json &event_page_json) {
     for (size_t line = 0, last_line = command_list.size(); line < last_line; ++line) {
         list.emplace_back(Command(command_list[line]));
     }
+
+    summary = PageSummary(list);
+}
+
+size_t EventPage::heap_bytes() const {
+
+    size_t bytes = memory_usage::heap_bytes(list);
+    for (const auto &command : list) {
+        bytes += command.heap_bytes();
+    }
+
+    return bytes;
 }
 
 bool Event::is_valid(const json &event_json) const {
     if (!event_json.contains("x") || !event_json["x"].is_number_integer()) {
-        log_err(R"(Event doesn't have a x position or it's not an integer!)");
+        report_validation_error(ValidationError::EVENT_X);
         return false;
     }
     if (!event_json.contains("y") || !event_json["y"].is_number_integer()) {
-        log_err(R"(Event doesn't have a y position or it's not an integer!)");
+        report_validation_error(ValidationError::EVENT_Y);
         return false;
     }
     if (!event_json.contains("name") || !event_json["name"].is_string()) {
-        log_err(R"(Event doesn't have a name or it's not a string!)");
+        report_validation_error(ValidationError::EVENT_NAME);
         return false;
     }
     if (!event_json.contains("note") || !event_json["note"].is_string()) {
-        log_err(R"(Event doesn't have a note or it's not a string!)");
+        report_validation_error(ValidationError::EVENT_NOTE);
         return false;
     }
     if (!event_json.contains("id") || !event_json["id"].is_number_integer()) {
-        log_err(R"(Event doesn't have an id or it's not an integer!)");
+        report_validation_error(ValidationError::EVENT_ID);
         return false;
     }
     if (!event_json.contains("pages")) {
-        log_err(R"(Event doesn't have pages!)");
+        report_validation_error(ValidationError::EVENT_PAGES);
         return false;
     }
 
@@ -163,36 +353,87 @@ Event::Event(const json &event_json) {
     x = event_json["x"].get<uint32_t>();
     y = event_json["y"].get<uint32_t>();
     id = event_json["id"].get<uint32_t>();
+    page_count = static_cast<uint32_t>(event_json["pages"].size());
+}
+
+EventDetails::EventDetails(const json &event_json) {
     name = event_json["name"].get<std::string_view>();
     note = event_json["note"].get<std::string_view>();
+}
+
+void MapEvents::layout(const json &events_json, const std::vector<size_t> &event_indices) {
+
+    events.resize(event_indices.size());
+    details.resize(event_indices.size());
+
+    uint32_t page_total = 0;
+    for (size_t i = 0, size = event_indices.size(); i < size; ++i) {
+        const auto &event_json = events_json[event_indices[i]];
+
+        events[i].first_page = page_total;
+
+        if (event_json.contains("pages")) {
+            page_total += static_cast<uint32_t>(event_json["pages"].size());
+        }
+    }
+
+    pages.resize(page_total);
+}
 
-    const auto page_count = event_json["pages"].size();
-    pages.reserve(page_count);
+void MapEvents::build_event(size_t index, const json &event_json) {
 
-    for (size_t page_num = 0; page_num < page_count; ++page_num) {
-        pages.emplace_back(EventPage(event_json["pages"][page_num]));
+    const uint32_t first_page = events[index].first_page;
+
+    Event &event = events[index];
+    event = Event(event_json);
+    event.first_page = first_page;
+
+    // invalid events don't have any pages to walk
+    if (event.page_count == 0) {
+        return;
+    }
+
+    details[index] = EventDetails(event_json);
+
+    const auto &pages_json = event_json["pages"];
+    for (uint32_t page_num = 0; page_num < event.page_count; ++page_num) {
+        pages[first_page + page_num] = EventPage(pages_json[page_num]);
+    }
+}
+
+size_t MapEvents::heap_bytes() const {
+
+    size_t bytes = memory_usage::heap_bytes(events) + memory_usage::heap_bytes(pages) + memory_usage::heap_bytes(details);
+
+    for (const auto &page : pages) {
+        bytes += page.heap_bytes();
+    }
+    for (const auto &detail : details) {
+        bytes += memory_usage::heap_bytes(detail.name) + memory_usage::heap_bytes(detail.note);
     }
+
+    return bytes;
 }
 
 bool CommonEvent::is_valid(const json &common_event_json) const {
     if (!common_event_json.contains("id") || !common_event_json["id"].is_number_integer()) {
-        log_err(R"(CommonEvent doesn't have an id or it's not an integer!)");
+        report_validation_error(ValidationError::COMMON_EVENT_ID);
         return false;
     }
     if (!common_event_json.contains("name") || !common_event_json["name"].is_string()) {
-        log_err(R"(CommonEvent doesn't have a name or it's not a string!)");
+        report_validation_error(ValidationError::COMMON_EVENT_NAME);
         return false;
     }
     if (!common_event_json.contains("switchId") || !common_event_json["switchId"].is_number_integer()) {
-        log_err(R"(CommonEvent doesn't have a switch id or it's not an integer!)");
+        report_validation_error(ValidationError::COMMON_EVENT_SWITCH_ID);
         return false;
     }
     if (!common_event_json.contains("trigger") || !common_event_json["trigger"].is_number_integer()) {
-        log_err(R"(CommonEvent doesn't have a trigger or it's not an integer!)");
+        report_validation_error(ValidationError::COMMON_EVENT_TRIGGER);
         return false;
     }
     if (!common_event_json.contains("list")) {
-        log_err(R"(CommonEvent doesn't have commands!)");
+        report_validation_error(ValidationError::COMMON_EVENT_LIST);
         return false;
     }
 
@@ -203,6 +444,16 @@ bool CommonEvent::has_trigger() const {
     return trigger != CommonEventTrigger::NONE;
 }
 
+size_t CommonEvent::heap_bytes() const {
+
+    size_t bytes = memory_usage::heap_bytes(list) + memory_usage::heap_bytes(name);
+    for (const auto &command : list) {
+        bytes += command.heap_bytes();
+    }
+
+    return bytes;
+}
+
 CommonEvent::CommonEvent(const json &common_event_json) {
     if (!is_valid(common_event_json)) {
         return;
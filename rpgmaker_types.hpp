@@ -13,6 +13,41 @@ using variable_element =
 
 namespace RPGMaker {
 
+    // every way a piece of json can fail to load into one of the types below
+    // counted instead of logged one by one, projects can have thousands of them
+    enum class ValidationError : uint32_t {
+        COMMAND_CODE,
+        COMMAND_PARAMETERS,
+        CONDITION_SWITCH1_ID,
+        CONDITION_SWITCH1_VALID,
+        CONDITION_SWITCH2_ID,
+        CONDITION_SWITCH2_VALID,
+        CONDITION_VARIABLE_ID,
+        CONDITION_VARIABLE_VALID,
+        CONDITION_VARIABLE_VALUE,
+        EVENT_PAGE_CONDITIONS,
+        EVENT_PAGE_LIST,
+        EVENT_X,
+        EVENT_Y,
+        EVENT_NAME,
+        EVENT_NOTE,
+        EVENT_ID,
+        EVENT_PAGES,
+        COMMON_EVENT_ID,
+        COMMON_EVENT_NAME,
+        COMMON_EVENT_SWITCH_ID,
+        COMMON_EVENT_TRIGGER,
+        COMMON_EVENT_LIST,
+        COUNT, // keep this last
+    };
+
+    // count a validation error, safe to call from any thread
+    void report_validation_error(ValidationError error);
+
+    // log one line per kind of validation error counted so far and reset the counters
+    // returns how many errors there were in total
+    uint32_t log_validation_summary();
+
     enum class CommonEventTrigger : uint32_t {
         NONE,
         AUTORUN,
@@ -77,24 +112,80 @@ namespace RPGMaker {
             return code == CommandCode::CONTROL_VARIABLE;
         }
 
+        // estimate of the bytes held outside of the command itself
+        size_t heap_bytes() const;
+
         CommandCode code{};
         std::vector<variable_element> parameters{};
     };
 
+    // The conditions of an event page, the valid flags are packed into a single byte
     struct Condition {
 
+        // bits of valid, switch1 and switch2 are laid out like HitAction::operation
+        static constexpr uint8_t switch1_valid_bit = 1 << 0;
+        static constexpr uint8_t switch2_valid_bit = 1 << 1;
+        static constexpr uint8_t variable_valid_bit = 1 << 2;
+
         Condition() = default;
         Condition(const json &condition_json);
 
         bool is_valid(const json &condition_json) const;
 
+        bool switch1_valid() const {
+            return valid & switch1_valid_bit;
+        }
+
+        bool switch2_valid() const {
+            return valid & switch2_valid_bit;
+        }
+
+        bool variable_valid() const {
+            return valid & variable_valid_bit;
+        }
+
+        // whether the switch or variable id is one of the ids the condition is on
+        bool references(uint32_t id, bool switches) const {
+            return switches ? (switch1_id == id || switch2_id == id) : variable_id == id;
+        }
+
         uint32_t switch1_id{};
-        bool switch1_valid{};
         uint32_t switch2_id{};
-        bool switch2_valid{};
         uint32_t variable_id{};
-        bool variable_valid{};
         uint32_t variable_value{};
+        uint8_t valid{};
+    };
+
+    // What the commands of a page can reference, worked out once while loading
+    // so a query can skip every page that can't hold a hit without walking its commands
+    struct PageSummary {
+
+        static constexpr uint8_t has_if_statement = 1 << 0;
+        static constexpr uint8_t has_control_switch = 1 << 1;
+        static constexpr uint8_t has_control_variable = 1 << 2;
+        // a line of script, which can mention any id
+        static constexpr uint8_t has_script = 1 << 3;
+        // a command the matchers don't read the way the summary expects, its page is always walked
+        static constexpr uint8_t has_unexpected = 1 << 4;
+
+        PageSummary() = default;
+        PageSummary(const std::vector<Command> &list);
+
+        // whether any command of the page could reference the switch or variable id
+        bool may_reference(uint32_t id, bool switches) const {
+            if (flags & (has_script | has_unexpected)) {
+                return true;
+            }
+            return switches ? (id >= min_switch_id && id <= max_switch_id) :
+                (id >= min_variable_id && id <= max_variable_id);
+        }
+
+        uint8_t flags{};
+        // the lowest and highest ids referenced outside of scripts, min is above max when there are none
+        uint32_t min_variable_id = UINT32_MAX;
+        uint32_t max_variable_id = 0;
+        uint32_t min_switch_id = UINT32_MAX;
+        uint32_t max_switch_id = 0;
     };
 
     struct EventPage {
@@ -104,10 +195,16 @@ namespace RPGMaker {
 
         bool is_valid(const json &event_page_json) const;
 
+        // estimate of the bytes held outside of the page itself
+        size_t heap_bytes() const;
+
         Condition conditions{};
+        PageSummary summary{};
         std::vector<Command> list{};
     };
 
+    // The part of an event the scraper walks over
+    // its pages live in MapEvents::pages at [first_page, first_page + page_count)
     struct Event {
 
         Event() = default;
@@ -116,11 +213,50 @@ namespace RPGMaker {
         bool is_valid(const json &event_json) const;
 
         uint32_t id{};
+        uint32_t x{};
+        uint32_t y{};
+        uint32_t first_page{};
+        uint32_t page_count{};
+    };
+
+    // The part of an event that's only needed once a hit is printed
+    struct EventDetails {
+
+        EventDetails() = default;
+        EventDetails(const json &event_json);
+
         std::string name{};
         std::string note{};
+    };
+
+    // All the events of a single map
+    // events, their pages and their details are each stored contiguously
+    // so walking pages and commands doesn't drag names and notes along
+    struct MapEvents {
+
+        MapEvents() = default;
+
+        // make room for the given entries of events_json and lay out their pages
+        void layout(const json &events_json, const std::vector<size_t> &event_indices);
+
+        // build the event at index from its json, the layout has to be done already
+        // different indices can be built from different threads at the same time
+        void build_event(size_t index, const json &event_json);
+
+        bool empty() const {
+            return events.empty();
+        }
+
+        const EventPage &get_page(const Event &event, uint32_t page_num) const {
+            return pages[event.first_page + page_num];
+        }
+
+        // estimate of the bytes held by every event, page, command and detail
+        size_t heap_bytes() const;
+
+        std::vector<Event> events{};
         std::vector<EventPage> pages{};
-        uint32_t x{};
-        uint32_t y{};
+        std::vector<EventDetails> details{};
     };
 
     struct CommonEvent {
@@ -132,6 +268,9 @@ namespace RPGMaker {
 
         bool has_trigger() const;
 
+        // estimate of the bytes held outside of the common event itself
+        size_t heap_bytes() const;
+
         uint32_t id{};
         std::vector<Command> list{};
         std::string name{};
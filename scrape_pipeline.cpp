@@ -0,0 +1,270 @@
+#include "scrape_pipeline.hpp"
+
+#include "bounded_queue.hpp"
+#include "logger.hpp"
+#include "result_sink.hpp"
+#include "tracer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// the raw content of a map file, read but not parsed yet
+// maps that couldn't be read are still passed along, so every map reaches the collector
+struct raw_map {
+    uint32_t map_id{};
+    std::optional<std::string> buffer{};
+};
+
+// every event of a single map, parsed but not matched yet
+struct parsed_map {
+    uint32_t map_id{};
+    MapEvents events{};
+};
+
+// every event of a single map along with the hits found in it
+struct matched_map {
+    uint32_t map_id{};
+    MapEvents events{};
+    EventMapResults hits{};
+};
+
+// pop from queue, traced as a span named after what's being waited on
+template<typename T>
+static bool traced_pop(bounded_queue<T> &queue, T &value, const std::atomic<bool> &cancelled, std::string_view waiting_for) {
+    const tracer::scoped_span span(waiting_for);
+    return queue.pop(value, cancelled);
+}
+
+ScrapePipeline::ScrapePipeline(ScrapeMode mode, uint32_t id, PipelineOptions _options, task_scheduler &_scheduler) :
+    options(_options), scheduler(_scheduler) {
+
+    const uint32_t hardware_threads = std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+
+    // the reader and the scheduler, which loads and scrapes the common events meanwhile, take a thread each
+    // whatever the scheduler has on top of that sleeps while it has no work
+    const uint32_t stage_threads = hardware_threads > 2 ? hardware_threads - 2 : 1;
+
+    // parsing is by far the most expensive stage, matching a map is cheap
+    if (options.matcher_threads == 0) {
+        options.matcher_threads = std::max<uint32_t>(stage_threads / 4, 1);
+    }
+    if (options.parser_threads == 0) {
+        options.parser_threads = stage_threads > options.matcher_threads ? stage_threads - options.matcher_threads : 1;
+    }
+
+    project.reset(new RPGMakerProject(RPGMakerProject::deferred_maps_t{}, std::filesystem::current_path()));
+    project->load_names();
+
+    scraper = std::make_unique<RPGMakerScraper>(*project, mode, id);
+}
+
+ScrapeResults ScrapePipeline::run() {
+
+    const tracer::scoped_span span("scrape");
+
+    const std::vector<uint32_t> map_ids = project->collect_map_ids();
+
+    bounded_queue<raw_map> raw_maps(options.queue_capacity);
+    bounded_queue<parsed_map> parsed_maps(options.queue_capacity);
+    bounded_queue<matched_map> matched_maps(options.queue_capacity);
+
+    // stop every stage as soon as one of them fails or enough hits were found
+    std::atomic<bool> cancelled{false};
+    std::mutex error_mutex;
+    std::exception_ptr first_error{};
+
+    // wakes every stage sleeping on a queue, so it sees it was cancelled
+    const auto cancel = [&]() {
+        cancelled.store(true);
+        raw_maps.wake_all();
+        parsed_maps.wake_all();
+        matched_maps.wake_all();
+    };
+
+    const auto fail = [&](std::exception_ptr error) {
+        {
+            std::unique_lock<decltype(error_mutex)> lock(error_mutex);
+            if (!first_error) {
+                first_error = error;
+            }
+        }
+        cancel();
+    };
+
+    ScrapeResults scrape_results(*project, scraper->mode, scraper->query_id, scraper->query_name);
+
+    // the common events don't depend on any map, so they're loaded and scraped on the side
+    log_info(R"(scraping maps and common events...)");
+
+    task_group common_event_group(scheduler);
+    common_event_group.run([this, &scrape_results]() {
+        const tracer::scoped_span common_events_span("scrape_common_events");
+
+        project->scrape_common_events(scheduler);
+        scraper->scrape_common_events(scheduler, scrape_results.common_event_results);
+
+        if (options.sink) {
+            for (const auto &[common_event_id, hits] : scrape_results.common_event_results) {
+                options.sink->on_common_event_hits(common_event_id, hits, scrape_results.get_formatter());
+            }
+        }
+
+        // the results keep their own copy of the names they need
+        if (!options.retain_events) {
+            project->all_common_events = {};
+        }
+    });
+
+    // read every map file in order
+    // every stage traces how long it waits on the one before or after it, so stalls show up
+    std::thread reader([&]() {
+        tracer::get().name_thread("reader");
+
+        try {
+            for (const auto map_id : map_ids) {
+                auto buffer = project->read_map_file(map_id);
+
+                const tracer::scoped_span wait_span("wait_for_parsers", map_id);
+                if (!raw_maps.push({map_id, std::move(buffer)}, cancelled)) {
+                    break;
+                }
+            }
+        } catch (...) {
+            fail(std::current_exception());
+        }
+
+        raw_maps.close();
+    });
+
+    // parse raw map files into events
+    std::atomic<uint32_t> parsers_running{options.parser_threads};
+    std::vector<std::thread> parsers{};
+
+    for (uint32_t i = 0; i < options.parser_threads; ++i) {
+        parsers.emplace_back([&]() {
+            tracer::get().name_thread("parser");
+
+            try {
+                raw_map raw{};
+                while (traced_pop(raw_maps, raw, cancelled, "wait_for_reader")) {
+                    parsed_map parsed{raw.map_id};
+
+                    if (raw.buffer) {
+                        const auto map_json = project->parse_map_file(raw.map_id, *raw.buffer);
+                        raw.buffer = {};
+
+                        if (map_json) {
+                            project->build_map_events(map_json, parsed.events, nullptr);
+                        }
+                    }
+
+                    if (!parsed_maps.push(std::move(parsed), cancelled)) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+
+            if (parsers_running.fetch_sub(1) == 1) {
+                parsed_maps.close();
+            }
+        });
+    }
+
+    // match the query against every parsed map
+    std::atomic<uint32_t> matchers_running{options.matcher_threads};
+    std::vector<std::thread> matchers{};
+
+    for (uint32_t i = 0; i < options.matcher_threads; ++i) {
+        matchers.emplace_back([&]() {
+            tracer::get().name_thread("matcher");
+
+            try {
+                parsed_map parsed{};
+                while (traced_pop(parsed_maps, parsed, cancelled, "wait_for_parsers")) {
+                    matched_map matched{parsed.map_id, std::move(parsed.events)};
+
+                    scraper->scrape_map_events(matched.events, 0, matched.events.events.size(), matched.hits);
+
+                    if (!matched_maps.push(std::move(matched), cancelled)) {
+                        break;
+                    }
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+
+            if (matchers_running.fetch_sub(1) == 1) {
+                matched_maps.close();
+            }
+        });
+    }
+
+    // hits per map in map_ids order, -1 while the map is still in flight
+    // the maps before leading_map are all done and hold leading_hits hits together
+    std::vector<int64_t> map_hit_counts(map_ids.size(), -1);
+    size_t leading_map = 0;
+    size_t leading_hits = 0;
+
+    // collect the hits and either hand the events over to the project or free them
+    // moving the vectors keeps the events where the hits point at
+    matched_map matched{};
+    while (matched_maps.pop(matched, cancelled)) {
+        if (options.hit_limit) {
+            const auto position = std::lower_bound(map_ids.begin(), map_ids.end(), matched.map_id) - map_ids.begin();
+            map_hit_counts[position] = static_cast<int64_t>(matched.hits.size());
+
+            while (leading_map < map_hit_counts.size() && map_hit_counts[leading_map] >= 0) {
+                leading_hits += static_cast<size_t>(map_hit_counts[leading_map++]);
+            }
+
+            // the maps still in flight can only come after the ones that are enough already
+            if (leading_hits >= options.hit_limit && leading_map < map_ids.size()) {
+                log_info(R"(found %d hits in the first %d maps, skipping the rest...)", leading_hits, leading_map);
+                cancel();
+            }
+        }
+
+        if (options.sink && !matched.hits.empty()) {
+            options.sink->on_map_hits(matched.map_id, matched.hits, scrape_results.get_formatter());
+        }
+        if (!options.retain_events) {
+            scrape_results.detach_events(matched.hits);
+            matched.events = {};
+        }
+        if (!matched.hits.empty()) {
+            scrape_results.results[matched.map_id] = std::move(matched.hits);
+        }
+        if (!matched.events.empty()) {
+            project->all_events[matched.map_id] = std::move(matched.events);
+        }
+    }
+
+    reader.join();
+    for (auto &parser : parsers) {
+        parser.join();
+    }
+    for (auto &matcher : matchers) {
+        matcher.join();
+    }
+
+    try {
+        common_event_group.wait();
+    } catch (...) {
+        fail(std::current_exception());
+    }
+
+    if (first_error) {
+        std::rethrow_exception(first_error);
+    }
+
+    log_validation_summary();
+
+    return scrape_results;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "rpgmaker_project.hpp"
+#include "rpgmaker_scraper.hpp"
+#include "task_scheduler.hpp"
+
+class ResultSink;
+
+struct PipelineOptions {
+    // 0 picks a count based on the hardware
+    uint32_t parser_threads = 0;
+    uint32_t matcher_threads = 0;
+    // how many maps may wait in between two stages
+    size_t queue_capacity = 8;
+    // keep every parsed event inside the project once it's been matched
+    // when off, each map is freed right after matching and only the details
+    // of the events that had hits are kept inside the results
+    bool retain_events = true;
+    // handed every map's hits as soon as they're matched, not owned
+    ResultSink *sink = nullptr;
+    // stop reading maps once the maps before the ones still in flight hold this many hits
+    // later maps are left out of the results entirely, 0 scrapes every map
+    size_t hit_limit = 0;
+};
+
+// Loads a project and scrapes it for a single query at the same time.
+// A reader thread feeds raw map files to parser threads, which hand every
+// map's events over to matcher threads. The stages are connected through
+// bounded queues, so reading, parsing and matching overlap while only a
+// handful of maps are in flight at once.
+class ScrapePipeline {
+public:
+
+    // loads the names of the project and verifies the id
+    // throws several types of exceptions
+    ScrapePipeline(ScrapeMode mode, uint32_t id, PipelineOptions _options = {},
+                   task_scheduler &_scheduler = task_scheduler::get_default());
+
+    ~ScrapePipeline() = default;
+
+    // runs every stage until all maps and common events are scraped
+    // rethrows the first exception any of the stages ran into
+    ScrapeResults run();
+
+    // the project that was loaded, complete once run() returns
+    // without retain_events it only holds the names
+    __forceinline const RPGMakerProject &get_project() const {
+        return *project;
+    }
+
+private:
+
+    PipelineOptions options{};
+
+    task_scheduler &scheduler;
+
+    // the project being filled by the pipeline
+    std::unique_ptr<RPGMakerProject> project{};
+
+    // the query matched against every map, refers to project
+    std::unique_ptr<RPGMakerScraper> scraper{};
+};
@@ -0,0 +1,232 @@
+#include "scraper_api.h"
+
+#include "logger.hpp"
+#include "result_sink.hpp"
+#include "rpgmaker_project.hpp"
+#include "rpgmaker_scraper.hpp"
+
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct rpgms_project {
+    explicit rpgms_project(const char *project_folder) : project(std::filesystem::u8path(project_folder)) {}
+
+    RPGMakerProject project;
+};
+
+struct rpgms_results {
+    explicit rpgms_results(ScrapeResults &&_results) : results(std::move(_results)) {}
+
+    // owns the names of common event hits and whatever event details were detached
+    ScrapeResults results;
+
+    std::vector<rpgms_hit> hits{};
+
+    // every formatted action, a deque so handing them out as pointers stays valid while it grows
+    std::deque<std::string> formatted_actions{};
+};
+
+static thread_local std::string last_error{};
+
+// run call, turning anything it throws into the last error of the thread
+// returns fallback if it threw
+template<typename call_t, typename result_t>
+static result_t guarded(const call_t &call, result_t fallback) {
+    try {
+        last_error.clear();
+        return call();
+    } catch (const std::exception &e) {
+        last_error = e.what();
+    } catch (...) {
+        last_error = "unknown error";
+    }
+    return fallback;
+}
+
+// the stream the logger writes to once rpgms_set_log was called
+// cuts whatever the logger writes into lines and hands each of them to the callback
+class CallbackLogBuffer : public std::streambuf {
+public:
+    void set_callback(rpgms_log_callback _callback, void *_user) {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+        callback = _callback;
+        user = _user;
+        line.clear();
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            const char character = traits_type::to_char_type(c);
+            xsputn(&character, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *text, std::streamsize count) override {
+        std::lock_guard<std::mutex> lock(callback_mutex);
+
+        for (std::streamsize i = 0; i < count; ++i) {
+            if (text[i] != '\n') {
+                line.push_back(text[i]);
+                continue;
+            }
+
+            if (callback) {
+                callback(line.c_str(), user);
+            }
+            line.clear();
+        }
+        return count;
+    }
+
+private:
+    std::mutex callback_mutex;
+    rpgms_log_callback callback = nullptr;
+    void *user = nullptr;
+    std::string line{};
+};
+
+// flattens every hit handed to it into the records rpgms_get_result hands out
+// send_to calls it from a single thread, so nothing needs to be locked
+class FlatResultSink : public ResultSink {
+public:
+    FlatResultSink(const RPGMakerProject &_project, rpgms_results &_flat) : project(_project), flat(_flat) {}
+
+    ~FlatResultSink() override = default;
+
+    void on_map_hits(uint32_t map_id, const EventMapResults &hits, const ActionFormatter &formatter) override {
+
+        const auto &map_names = project.get_map_info_names();
+        const auto map_name = map_names.find(map_id);
+
+        for (const auto &hit : hits) {
+            rpgms_hit &record = add(hit, formatter);
+            record.map_id = map_id;
+            record.event_id = hit.event_info.id;
+            record.event_page = hit.event_page;
+            record.x = hit.event_info.x;
+            record.y = hit.event_info.y;
+            record.map_name = map_name != map_names.end() ? map_name->second.c_str() : "";
+            record.name = hit.event_details->name.c_str();
+        }
+    }
+
+    void on_common_event_hits(uint32_t common_event_id, const ResultInformationBases &hits, const ActionFormatter &formatter) override {
+
+        for (const auto &hit : hits) {
+            rpgms_hit &record = add(hit, formatter);
+            record.common_event_id = common_event_id;
+            record.name = hit.name.c_str();
+        }
+    }
+
+private:
+
+    // the record of a hit with everything maps and common events share filled in
+    rpgms_hit &add(const ResultInformationBase &hit, const ActionFormatter &formatter) {
+
+        auto &formatted_action = flat.formatted_actions.emplace_back();
+        formatter.append_to(formatted_action, hit.action);
+
+        rpgms_hit &record = flat.hits.emplace_back();
+        record.access = static_cast<rpgms_access>(hit.access_type);
+        record.action = static_cast<rpgms_action>(hit.action.type);
+        record.active = hit.active ? 1 : 0;
+        record.line_number = hit.line_number.value_or(0);
+        record.map_name = "";
+        record.formatted_action = formatted_action.c_str();
+        return record;
+    }
+
+    const RPGMakerProject &project;
+
+    rpgms_results &flat;
+};
+
+uint32_t rpgms_api_version(void) {
+    return RPGMS_API_VERSION;
+}
+
+rpgms_project *rpgms_open_project(const char *project_folder) {
+
+    if (!project_folder) {
+        last_error = "no project folder given";
+        return nullptr;
+    }
+
+    return guarded([&]() { return new rpgms_project(project_folder); }, static_cast<rpgms_project *>(nullptr));
+}
+
+void rpgms_close_project(rpgms_project *project) {
+    delete project;
+}
+
+rpgms_results *rpgms_run_query(const rpgms_project *project, rpgms_mode mode, uint32_t id) {
+
+    if (!project || (mode != RPGMS_MODE_VARIABLES && mode != RPGMS_MODE_SWITCHES)) {
+        last_error = "invalid project or mode";
+        return nullptr;
+    }
+
+    return guarded([&]() {
+        const RPGMakerScraper scraper(project->project, static_cast<ScrapeMode>(mode), id);
+
+        auto flat = std::make_unique<rpgms_results>(scraper.scrape());
+        flat->hits.reserve(flat->results.calculate_instances());
+
+        FlatResultSink sink(project->project, *flat);
+        flat->results.send_to(sink);
+
+        return flat.release();
+    }, static_cast<rpgms_results *>(nullptr));
+}
+
+size_t rpgms_result_count(const rpgms_results *results) {
+    return results ? results->hits.size() : 0;
+}
+
+int rpgms_get_result(const rpgms_results *results, size_t index, rpgms_hit *hit) {
+
+    if (!results || !hit || index >= results->hits.size()) {
+        return 0;
+    }
+
+    *hit = results->hits[index];
+    return 1;
+}
+
+void rpgms_free_results(rpgms_results *results) {
+    delete results;
+}
+
+int rpgms_set_log(rpgms_log_level level, rpgms_log_callback callback, void *user) {
+
+    if (level < RPGMS_LOG_FATAL || level > RPGMS_LOG_DEBUG) {
+        last_error = "invalid log level";
+        return 0;
+    }
+
+    auto &log = logger::get();
+
+    // never freed, the logger may still write to it while the process exits
+    static auto *const buffer = new CallbackLogBuffer();
+    static auto *const stream = new std::ostream(buffer);
+
+    // whatever was logged before goes to the callback it was logged for
+    log.flush();
+    buffer->set_callback(callback, user);
+
+    log.set_level(callback ? static_cast<log_level>(level) : log_level::LOG_FATAL);
+    log.set_stream(*stream);
+    return 1;
+}
+
+const char *rpgms_last_error(void) {
+    return last_error.c_str();
+}
@@ -0,0 +1,135 @@
+#ifndef RPGMAKER_SCRAPER_API_H
+#define RPGMAKER_SCRAPER_API_H
+
+/*
+ * The C interface of the scraper, for calling it in-process instead of spawning the executable.
+ * Build every source but main.cpp with SCRAPER_LIBRARY defined into a shared library, e.g.
+ *   g++ -std=c++17 -O2 -shared -fPIC -fvisibility=hidden -DSCRAPER_LIBRARY $(ls *.cpp | grep -v main.cpp) -o librpgmakerscraper.so -lpthread
+ * A library built like that never touches the console or the allocator of the process,
+ * it only logs through the callback rpgms_set_log gives it.
+ *
+ * Nothing here throws. Functions that fail return NULL or 0, rpgms_last_error()
+ * then tells what went wrong on the calling thread.
+ * A project is never modified once it's open, any amount of threads may run queries on it at once.
+ * Every struct and enum here only ever grows at the end, RPGMS_API_VERSION is bumped whenever they do.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef SCRAPER_LIBRARY
+#define RPGMS_API __declspec(dllexport)
+#else
+#define RPGMS_API __declspec(dllimport)
+#endif
+#else
+#define RPGMS_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RPGMS_API_VERSION 1
+
+typedef struct rpgms_project rpgms_project;
+typedef struct rpgms_results rpgms_results;
+
+/* what a query looks for, the same as -v and -s */
+typedef enum rpgms_mode {
+    RPGMS_MODE_VARIABLES = 0,
+    RPGMS_MODE_SWITCHES = 1,
+} rpgms_mode;
+
+/* whether a hit reads or writes what was queried */
+typedef enum rpgms_access {
+    RPGMS_ACCESS_NONE = 0,
+    RPGMS_ACCESS_READ = 1,
+    RPGMS_ACCESS_WRITE = 2,
+    RPGMS_ACCESS_READWRITE = 3,
+} rpgms_access;
+
+/* what kind of command or condition a hit was found in */
+typedef enum rpgms_action {
+    RPGMS_ACTION_NONE = 0,
+    RPGMS_ACTION_EVENT_PAGE_CONDITION = 1,
+    RPGMS_ACTION_IF_STATEMENT = 2,
+    RPGMS_ACTION_CONTROL_VARIABLE = 3,
+    RPGMS_ACTION_CONTROL_SWITCH = 4,
+    RPGMS_ACTION_SCRIPT = 5,
+    RPGMS_ACTION_COMMON_EVENT_TRIGGER = 6,
+} rpgms_action;
+
+/* how much the library logs, the same levels as --log-level */
+typedef enum rpgms_log_level {
+    RPGMS_LOG_FATAL = 0,
+    RPGMS_LOG_ERROR = 1,
+    RPGMS_LOG_WARN = 2,
+    RPGMS_LOG_OK = 3,
+    RPGMS_LOG_INFO = 4,
+    RPGMS_LOG_DEBUG = 5,
+} rpgms_log_level;
+
+/* handed every line the library logs without its newline, on the library's own logging thread */
+typedef void (*rpgms_log_callback)(const char *line, void *user);
+
+/* a single hit, the strings belong to the results and live as long as they do */
+typedef struct rpgms_hit {
+    /* the map the hit is on, 0 for hits in common events */
+    uint32_t map_id;
+    /* the common event the hit is in, 0 for hits on maps */
+    uint32_t common_event_id;
+    /* the event, its page and where it stands, all 0 for common events */
+    uint32_t event_id;
+    uint32_t event_page;
+    uint32_t x;
+    uint32_t y;
+    rpgms_access access;
+    rpgms_action action;
+    /* whether the hit is in code the game actually runs */
+    int active;
+    /* the 1-based index of the command in its event page or common event, 0 for page conditions and triggers */
+    uint32_t line_number;
+    /* the name of the map, empty for common events */
+    const char *map_name;
+    /* the name of the event or common event */
+    const char *name;
+    /* the hit as the executable prints it, e.g. "ON [WRITE]" */
+    const char *formatted_action;
+} rpgms_hit;
+
+/* the RPGMS_API_VERSION the library was built with */
+RPGMS_API uint32_t rpgms_api_version(void);
+
+/* load the project in the 'data' folder of project_folder, NULL if it couldn't be loaded */
+RPGMS_API rpgms_project *rpgms_open_project(const char *project_folder);
+
+/* free a project, every result set of it has to be freed before */
+RPGMS_API void rpgms_close_project(rpgms_project *project);
+
+/* look for every reference to the variable or switch id, NULL if the id doesn't exist */
+RPGMS_API rpgms_results *rpgms_run_query(const rpgms_project *project, rpgms_mode mode, uint32_t id);
+
+/* how many hits a query found, maps come first, then common events, both in id order */
+RPGMS_API size_t rpgms_result_count(const rpgms_results *results);
+
+/* fill hit with the hit at index, 0 if index is out of range */
+RPGMS_API int rpgms_get_result(const rpgms_results *results, size_t index, rpgms_hit *hit);
+
+/* free the hits of a query */
+RPGMS_API void rpgms_free_results(rpgms_results *results);
+
+/* send every line logged at level or anything more severe to callback, along with user
+ * nothing is logged until this is called, a NULL callback stops logging again
+ * returns 0 if level isn't one of rpgms_log_level */
+RPGMS_API int rpgms_set_log(rpgms_log_level level, rpgms_log_callback callback, void *user);
+
+/* what the last call that failed on this thread ran into, empty if nothing did */
+RPGMS_API const char *rpgms_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,293 @@
+#include "stats.hpp"
+
+#include "json_writer.hpp"
+#include "logger.hpp"
+#include "output_renderer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+using colors = logger::console_colors;
+
+static constexpr std::array<std::string_view, static_cast<size_t>(stats_counter::COUNT)> counter_names = {
+    "bytes_read",
+    "files_parsed",
+    "events_visited",
+    "pages_visited",
+    "pages_skipped",
+    "common_events_visited",
+    "commands_visited",
+    "commands_skipped",
+    "script_lines_scanned",
+    "hits_event_page_condition",
+    "hits_if_statement",
+    "hits_control_variable",
+    "hits_control_switch",
+    "hits_script",
+    "hits_common_event_trigger",
+};
+
+// a thread's block, known to stats for as long as the thread runs
+// whatever it counted is kept once the thread exits
+struct registered_block {
+    registered_block() {
+        auto &instance = stats::get();
+        std::unique_lock<decltype(instance.blocks_mutex)> lock(instance.blocks_mutex);
+        instance.live_blocks.push_back(&counts);
+    }
+
+    ~registered_block() {
+        auto &instance = stats::get();
+        std::unique_lock<decltype(instance.blocks_mutex)> lock(instance.blocks_mutex);
+        stats::add_block(instance.retired, counts);
+        instance.live_blocks.erase(std::find(instance.live_blocks.begin(), instance.live_blocks.end(), &counts));
+    }
+
+    stats::block counts{};
+};
+
+stats::block &stats::local() {
+    thread_local registered_block registered{};
+    return registered.counts;
+}
+
+void stats::enable() {
+    wall_start = std::chrono::steady_clock::now();
+    cpu_start = process_cpu_ns();
+    enabled.store(true);
+}
+
+void stats::add_block(totals &sum, const block &counts) {
+
+    for (size_t i = 0; i < sum.counters.size(); ++i) {
+        sum.counters[i] += counts.counters[i].get();
+    }
+    for (size_t i = 0; i < sum.command_codes.size(); ++i) {
+        sum.command_codes[i] += counts.command_codes[i].get();
+    }
+    for (size_t i = 0; i < sum.phases.size(); ++i) {
+        sum.phases[i][0] += counts.phases[i].calls.get();
+        sum.phases[i][1] += counts.phases[i].wall_ns.get();
+        sum.phases[i][2] += counts.phases[i].cpu_ns.get();
+        for (size_t event = 0; event < sum.phase_events[i].size(); ++event) {
+            sum.phase_events[i][event] += counts.phases[i].events[event].get();
+        }
+        sum.phase_multiplexed[i] += counts.phases[i].multiplexed.get();
+    }
+}
+
+stats::totals stats::sum() const {
+
+    std::unique_lock<decltype(blocks_mutex)> lock(blocks_mutex);
+
+    totals result = retired;
+    for (const auto *counts : live_blocks) {
+        add_block(result, *counts);
+    }
+
+    if (is_enabled()) {
+        result.wall_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - wall_start).count());
+        result.cpu_ns = process_cpu_ns() - cpu_start;
+    }
+
+    return result;
+}
+
+uint64_t stats::thread_cpu_ns() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    const auto to_ns = [](const FILETIME &time) {
+        return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+    };
+    return to_ns(kernel) + to_ns(user);
+#else
+    timespec now{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+#endif
+}
+
+uint64_t stats::process_cpu_ns() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) {
+        return 0;
+    }
+    const auto to_ns = [](const FILETIME &time) {
+        return ((static_cast<uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 100;
+    };
+    return to_ns(kernel) + to_ns(user);
+#else
+    timespec now{};
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ull + static_cast<uint64_t>(now.tv_nsec);
+#endif
+}
+
+// nanoseconds as milliseconds with 3 decimals, e.g. 12.345
+static void append_ms(output_renderer &renderer, uint64_t ns) {
+    renderer.append(format_literal("%d.%03d"), ns / 1000000, (ns / 1000) % 1000);
+}
+
+void stats::print() const {
+
+    const totals total = sum();
+
+    output_renderer renderer(logger::get().colors_enabled(), 8 * 1024);
+
+    renderer.append_raw("=========================================\n");
+    renderer.append_colored(colors::CYAN, colors::BLACK, format_literal("stats"));
+    renderer.append_raw(" (phase times are summed over every thread that ran them)\n");
+    renderer.append_raw("=========================================\n");
+
+    for (size_t i = 0; i < phase_names.size(); ++i) {
+        const auto &[calls, wall_ns, cpu_ns] = total.phases[i];
+        if (calls == 0) {
+            continue;
+        }
+
+        renderer.append(format_literal("%s"), phase_names[i]);
+        for (size_t pad = phase_names[i].size(); pad < 22; ++pad) {
+            renderer.append_raw(" ");
+        }
+        renderer.append(format_literal("%8d calls  wall "), calls);
+        append_ms(renderer, wall_ns);
+        renderer.append_raw(" ms  cpu ");
+        append_ms(renderer, cpu_ns);
+        renderer.append_raw(" ms\n");
+    }
+
+    renderer.append_raw("total run                              wall ");
+    append_ms(renderer, total.wall_ns);
+    renderer.append_raw(" ms  cpu ");
+    append_ms(renderer, total.cpu_ns);
+    renderer.append_raw(" ms\n");
+
+    if (perf_counters::is_enabled()) {
+        renderer.append_raw("-----------------------------------------\n");
+        renderer.append_raw("hardware counters per phase (user space only)\n");
+        renderer.append_raw("phase                           cycles    instructions    ipc    cache misses   branch misses\n");
+
+        bool multiplexed = false;
+
+        for (size_t i = 0; i < phase_names.size(); ++i) {
+            if (total.phases[i][0] == 0) {
+                continue;
+            }
+
+            const auto &events = total.phase_events[i];
+            const uint64_t cycles = events[perf_counters::CYCLES];
+            // instructions per cycle in hundredths, e.g. 1.23
+            const uint64_t ipc = cycles ? events[perf_counters::INSTRUCTIONS] * 100 / cycles : 0;
+
+            renderer.append(format_literal("%s"), phase_names[i]);
+            for (size_t pad = phase_names[i].size(); pad < 22; ++pad) {
+                renderer.append_raw(" ");
+            }
+            renderer.append(format_literal("%16d%16d%5d.%02d%16d%16d%s\n"), cycles, events[perf_counters::INSTRUCTIONS], ipc / 100, ipc % 100,
+                events[perf_counters::CACHE_MISSES], events[perf_counters::BRANCH_MISSES], (total.phase_multiplexed[i] ? " *" : ""));
+            multiplexed = multiplexed || total.phase_multiplexed[i];
+        }
+
+        if (multiplexed) {
+            renderer.append_raw("* the kernel shared the counters with someone else meanwhile, these are scaled up estimates\n");
+        }
+    }
+
+    renderer.append_raw("-----------------------------------------\n");
+
+    for (size_t i = 0; i < counter_names.size(); ++i) {
+        renderer.append(format_literal("%s"), counter_names[i]);
+        for (size_t pad = counter_names[i].size(); pad < 28; ++pad) {
+            renderer.append_raw(" ");
+        }
+        renderer.append(format_literal("%d\n"), total.counters[i]);
+    }
+
+    renderer.append_raw("-----------------------------------------\n");
+    renderer.append_raw("commands per code (skipped pages aren't walked)\n");
+
+    for (size_t code = 0; code < total.command_codes.size(); ++code) {
+        if (total.command_codes[code] == 0) {
+            continue;
+        }
+        renderer.append(format_literal("\t%03d%s\t%d\n"), code, (code == max_command_code - 1 ? "+" : ""), total.command_codes[code]);
+    }
+
+    renderer.append_raw("=========================================\n");
+
+    renderer.write_to_console();
+}
+
+void stats::write_json(std::ostream &os) const {
+
+    const totals total = sum();
+
+    json_writer writer(os);
+    writer.begin_object();
+
+    writer.key("command_codes");
+    writer.begin_object();
+    for (size_t code = 0; code < total.command_codes.size(); ++code) {
+        if (total.command_codes[code] == 0) {
+            continue;
+        }
+
+        char key[16];
+        const auto [end, error] = std::to_chars(std::begin(key), std::end(key), code);
+        writer.field(std::string_view(key, end - key), total.command_codes[code]);
+    }
+    writer.end_object();
+
+    writer.key("counters");
+    writer.begin_object();
+    for (size_t i = 0; i < counter_names.size(); ++i) {
+        writer.field(counter_names[i], total.counters[i]);
+    }
+    writer.end_object();
+
+    writer.key("phases");
+    writer.begin_object();
+    for (size_t i = 0; i < phase_names.size(); ++i) {
+        const auto &[calls, wall_ns, cpu_ns] = total.phases[i];
+
+        writer.key(phase_names[i]);
+        writer.begin_object();
+        writer.field("calls", calls);
+        writer.field("cpu_ns", cpu_ns);
+        if (perf_counters::is_enabled()) {
+            writer.key("hardware");
+            writer.begin_object();
+            for (size_t event = 0; event < perf_counters::event_names.size(); ++event) {
+                writer.field(perf_counters::event_names[event], total.phase_events[i][event]);
+            }
+            // calls counted while the counters were multiplexed, their events are scaled estimates
+            writer.field("multiplexed_calls", total.phase_multiplexed[i]);
+            writer.end_object();
+        }
+        writer.field("wall_ns", wall_ns);
+        writer.end_object();
+    }
+    writer.end_object();
+
+    writer.key("total");
+    writer.begin_object();
+    writer.field("cpu_ns", total.cpu_ns);
+    writer.field("wall_ns", total.wall_ns);
+    writer.end_object();
+
+    writer.end_object();
+    writer.newline();
+}
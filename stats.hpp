@@ -0,0 +1,225 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+#include "perf_counters.hpp"
+#include "tracer.hpp"
+#include "utils.hpp"
+
+// the parts of a run that are timed, in the order they're reported
+enum class stats_phase : uint32_t {
+    POPULATE_MAP_NAMES,
+    POPULATE_NAMES,
+    READ_MAPS,
+    PARSE_MAPS,
+    BUILD_EVENTS,
+    LOAD_COMMON_EVENTS,
+    MATCH_MAPS,
+    MATCH_COMMON_EVENTS,
+    OUTPUT,
+    COUNT,
+};
+
+// everything that's counted during a run, in the order it's reported
+enum class stats_counter : uint32_t {
+    BYTES_READ,
+    FILES_PARSED,
+    EVENTS_VISITED,
+    PAGES_VISITED,
+    PAGES_SKIPPED,
+    COMMON_EVENTS_VISITED,
+    COMMANDS_VISITED,
+    COMMANDS_SKIPPED,
+    SCRIPT_LINES_SCANNED,
+    HITS_EVENT_PAGE_CONDITION,
+    HITS_IF_STATEMENT,
+    HITS_CONTROL_VARIABLE,
+    HITS_CONTROL_SWITCH,
+    HITS_SCRIPT,
+    HITS_COMMON_EVENT_TRIGGER,
+    COUNT,
+};
+
+// Counters and per-phase timings of a whole run, printed with --stats.
+// Every thread counts into its own block, so counting never contends;
+// the blocks are only summed up when a report is asked for.
+// Counting is always on since it's a plain add, timing a phase reads
+// clocks and only happens once enable() was called.
+// Phases are also recorded as spans while the tracer is enabled, and
+// count hardware events while perf_counters are enabled.
+class stats {
+public:
+    // command codes at or above this are counted together in the last slot
+    static constexpr uint32_t max_command_code = 1024;
+
+    // what every phase is called in reports and traces, in stats_phase order
+    static constexpr std::array<std::string_view, static_cast<size_t>(stats_phase::COUNT)> phase_names = {
+        "populate_map_names",
+        "populate_names",
+        "read_maps",
+        "parse_maps",
+        "build_events",
+        "load_common_events",
+        "match_maps",
+        "match_common_events",
+        "output",
+    };
+
+    // a counter only ever written by the thread owning it, so adding doesn't need a locked instruction
+    class counter {
+    public:
+        __forceinline void add(uint64_t amount) {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+
+        __forceinline uint64_t get() const {
+            return value.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic<uint64_t> value{0};
+    };
+
+    // how often a phase ran and how long it took, summed over every thread
+    struct phase_time {
+        counter calls{};
+        counter wall_ns{};
+        counter cpu_ns{};
+        std::array<counter, perf_counters::COUNT> events{};
+        // calls whose events had to be scaled up, because the kernel multiplexed the counters
+        counter multiplexed{};
+    };
+
+    // the counters of a single thread
+    struct block {
+        std::array<counter, static_cast<size_t>(stats_counter::COUNT)> counters{};
+        std::array<counter, max_command_code> command_codes{};
+        std::array<phase_time, static_cast<size_t>(stats_phase::COUNT)> phases{};
+
+        __forceinline void add(stats_counter which, uint64_t amount = 1) {
+            counters[static_cast<size_t>(which)].add(amount);
+        }
+
+        __forceinline void add_command(uint32_t code) {
+            command_codes[code < max_command_code ? code : max_command_code - 1].add(1);
+        }
+    };
+
+    // times the scope it lives in as the given phase, if timing is enabled
+    // and traces it as a span tagged with id, if tracing is enabled
+    class scoped_phase {
+    public:
+        explicit scoped_phase(stats_phase _phase, int64_t id = tracer::no_id) :
+            phase(_phase), timed(get().is_enabled()), span(phase_names[static_cast<size_t>(_phase)], id) {
+            if (timed) {
+                counted = perf_counters::is_enabled() && perf_counters::read(events_start);
+                wall_start = std::chrono::steady_clock::now();
+                cpu_start = thread_cpu_ns();
+            }
+        }
+
+        ~scoped_phase() {
+            if (!timed) {
+                return;
+            }
+
+            const auto wall = std::chrono::steady_clock::now() - wall_start;
+            auto &time = local().phases[static_cast<size_t>(phase)];
+
+            time.calls.add(1);
+            time.wall_ns.add(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count()));
+            time.cpu_ns.add(thread_cpu_ns() - cpu_start);
+
+            perf_counters::sample events_end{};
+            if (counted && perf_counters::read(events_end)) {
+                perf_counters::counts events{};
+                if (perf_counters::difference(events_start, events_end, events)) {
+                    time.multiplexed.add(1);
+                }
+                for (size_t i = 0; i < events.size(); ++i) {
+                    time.events[i].add(events[i]);
+                }
+            }
+        }
+
+        scoped_phase(const scoped_phase &) = delete;
+        scoped_phase &operator=(const scoped_phase &) = delete;
+
+    private:
+        stats_phase phase{};
+        bool timed = false;
+        std::chrono::steady_clock::time_point wall_start{};
+        uint64_t cpu_start = 0;
+        bool counted = false;
+        perf_counters::sample events_start{};
+        tracer::scoped_span span;
+    };
+
+    // never destroyed, threads may still hand in their counters while the program exits
+    static stats &get() {
+        static stats *instance = new stats();
+        return *instance;
+    }
+
+    // the counters of the calling thread
+    static block &local();
+
+    // shorthand for counting on the calling thread
+    static void add(stats_counter which, uint64_t amount = 1) {
+        local().add(which, amount);
+    }
+
+    // start timing phases, the run's total time is measured from here
+    void enable();
+
+    __forceinline bool is_enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // print every phase and counter to the console
+    void print() const;
+
+    // write every phase and counter as a single json object
+    void write_json(std::ostream &os) const;
+
+private:
+    friend struct registered_block;
+
+    stats() = default;
+
+    // the sum of every block, past and present
+    struct totals {
+        std::array<uint64_t, static_cast<size_t>(stats_counter::COUNT)> counters{};
+        std::array<uint64_t, max_command_code> command_codes{};
+        std::array<std::array<uint64_t, 3>, static_cast<size_t>(stats_phase::COUNT)> phases{};
+        std::array<perf_counters::counts, static_cast<size_t>(stats_phase::COUNT)> phase_events{};
+        std::array<uint64_t, static_cast<size_t>(stats_phase::COUNT)> phase_multiplexed{};
+        uint64_t wall_ns = 0;
+        uint64_t cpu_ns = 0;
+    };
+
+    totals sum() const;
+
+    static void add_block(totals &sum, const block &counts);
+
+    // cpu time spent by the calling thread and the whole process
+    static uint64_t thread_cpu_ns();
+    static uint64_t process_cpu_ns();
+
+    std::atomic<bool> enabled{false};
+
+    std::chrono::steady_clock::time_point wall_start{};
+    uint64_t cpu_start = 0;
+
+    // the blocks of threads that are still running, and what finished threads counted
+    mutable std::mutex blocks_mutex;
+    std::vector<const block *> live_blocks{};
+    totals retired{};
+};
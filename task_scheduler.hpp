@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "tracer.hpp"
+#include "utils.hpp"
+
+class task_group;
+
+// A small work-stealing thread pool.
+// Every worker owns a deque: it pushes and pops its own work at the back and
+// idle workers steal the oldest work from the front of someone else's deque.
+// Work is always submitted through a task_group, so independent callers can
+// share one scheduler and still only wait for their own tasks.
+// Workers without work sleep until something is pushed, so an idle scheduler costs nothing.
+class task_scheduler {
+public:
+
+    explicit task_scheduler(uint32_t thread_count = std::thread::hardware_concurrency()) {
+
+        thread_count = std::max<uint32_t>(thread_count, 1);
+
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            queues.emplace_back(std::make_unique<work_queue>());
+        }
+
+        for (uint32_t i = 0; i < thread_count; ++i) {
+            workers.emplace_back([this, i]() { worker_loop(i); });
+        }
+    }
+
+    ~task_scheduler() {
+        {
+            std::unique_lock<decltype(sleep_mutex)> lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_cv.notify_all();
+
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    task_scheduler(const task_scheduler &) = delete;
+    task_scheduler &operator=(const task_scheduler &) = delete;
+
+    // the process wide scheduler, created on first use
+    static task_scheduler &get_default() {
+        static task_scheduler scheduler{};
+        return scheduler;
+    }
+
+    __forceinline uint32_t get_thread_count() const {
+        return static_cast<uint32_t>(workers.size());
+    }
+
+private:
+    friend class task_group;
+
+    struct task {
+        std::function<void()> fn{};
+        task_group *group = nullptr;
+    };
+
+    struct work_queue {
+        std::mutex m;
+        std::deque<task> tasks;
+    };
+
+    // which worker of which scheduler the current thread is, if any
+    struct worker_identity {
+        const task_scheduler *scheduler = nullptr;
+        uint32_t index = 0;
+    };
+
+    static worker_identity &current_worker() {
+        static thread_local worker_identity identity{};
+        return identity;
+    }
+
+    void push(task &&t);
+
+    // pop from our own queue first, otherwise steal from the others
+    bool try_pop(uint32_t start_index, task &out) {
+
+        const auto queue_count = static_cast<uint32_t>(queues.size());
+
+        {
+            auto &own = *queues[start_index];
+            std::unique_lock<decltype(own.m)> lock(own.m);
+            if (!own.tasks.empty()) {
+                out = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (uint32_t offset = 1; offset < queue_count; ++offset) {
+            auto &victim = *queues[(start_index + offset) % queue_count];
+            std::unique_lock<decltype(victim.m)> lock(victim.m);
+            if (!victim.tasks.empty()) {
+                out = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void execute(task &t);
+
+    void worker_loop(uint32_t index) {
+
+        current_worker() = {this, index};
+        tracer::get().name_thread("worker");
+
+        while (true) {
+            // read before looking for work, any push after this changes it
+            const uint64_t seen = pushed.load(std::memory_order_acquire);
+
+            task t{};
+            if (try_pop(index, t)) {
+                execute(t);
+                continue;
+            }
+
+            std::unique_lock<decltype(sleep_mutex)> lock(sleep_mutex);
+            if (stopping) {
+                return;
+            }
+            sleep_cv.wait(lock, [&]() { return stopping || pushed.load(std::memory_order_acquire) != seen; });
+        }
+    }
+
+    std::vector<std::unique_ptr<work_queue>> queues{};
+    std::vector<std::thread> workers{};
+
+    std::atomic<uint32_t> next_queue{0};
+
+    // idle workers and waiting groups sleep on sleep_cv until a push bumps pushed
+    // it's only bumped with sleep_mutex held, so nobody misses the push they're waiting for
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<uint64_t> pushed{0};
+    bool stopping = false;
+};
+
+// A set of tasks that can be waited on together.
+// Tasks may spawn more tasks into the same group while running.
+class task_group {
+public:
+
+    explicit task_group(task_scheduler &_scheduler = task_scheduler::get_default()) : scheduler(_scheduler) {}
+
+    ~task_group() {
+        // never leave tasks behind that point at us
+        try {
+            wait();
+        } catch (...) {
+        }
+    }
+
+    task_group(const task_group &) = delete;
+    task_group &operator=(const task_group &) = delete;
+
+    void run(std::function<void()> fn) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        scheduler.push({std::move(fn), this});
+    }
+
+    // blocks until every task of this group is done, helping out meanwhile
+    // sleeps whenever there's nothing to help with, until a task is pushed or the last one finishes
+    // rethrows the first exception thrown by any of the tasks
+    void wait() {
+
+        const auto &identity = task_scheduler::current_worker();
+        const uint32_t start_index = identity.scheduler == &scheduler ? identity.index : 0;
+
+        bool woken = false;
+
+        while (pending.load(std::memory_order_acquire) != 0) {
+            const uint64_t seen = scheduler.pushed.load(std::memory_order_acquire);
+
+            task_scheduler::task t{};
+            if (scheduler.try_pop(start_index, t)) {
+                scheduler.execute(t);
+                woken = false;
+                continue;
+            }
+
+            std::unique_lock<decltype(scheduler.sleep_mutex)> lock(scheduler.sleep_mutex);
+            scheduler.sleep_cv.wait(lock, [&]() {
+                return pending.load(std::memory_order_acquire) == 0 || scheduler.pushed.load(std::memory_order_acquire) != seen;
+            });
+            woken = true;
+        }
+
+        // the push that woke us may have been meant for a worker, pass it on
+        if (woken) {
+            scheduler.sleep_cv.notify_one();
+        }
+
+        std::exception_ptr error{};
+        {
+            std::unique_lock<decltype(error_mutex)> lock(error_mutex);
+            std::swap(error, first_error);
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    friend class task_scheduler;
+
+    void finish(std::exception_ptr error) {
+        if (error) {
+            std::unique_lock<decltype(error_mutex)> lock(error_mutex);
+            if (!first_error) {
+                first_error = error;
+            }
+        }
+
+        // the group may be gone as soon as pending is 0, so the scheduler is taken beforehand
+        task_scheduler &owner = scheduler;
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::unique_lock<decltype(owner.sleep_mutex)> lock(owner.sleep_mutex);
+            owner.sleep_cv.notify_all();
+        }
+    }
+
+    task_scheduler &scheduler;
+    std::atomic<size_t> pending{0};
+
+    std::mutex error_mutex;
+    std::exception_ptr first_error{};
+};
+
+inline void task_scheduler::push(task &&t) {
+
+    const auto &identity = current_worker();
+
+    // workers keep their own work local, everyone else spreads it out
+    const uint32_t index = identity.scheduler == this ?
+        identity.index :
+        next_queue.fetch_add(1, std::memory_order_relaxed) % static_cast<uint32_t>(queues.size());
+
+    {
+        auto &queue = *queues[index];
+        std::unique_lock<decltype(queue.m)> lock(queue.m);
+        queue.tasks.push_back(std::move(t));
+    }
+
+    {
+        std::unique_lock<decltype(sleep_mutex)> lock(sleep_mutex);
+        pushed.fetch_add(1, std::memory_order_release);
+    }
+    sleep_cv.notify_one();
+}
+
+inline void task_scheduler::execute(task &t) {
+
+    std::exception_ptr error{};
+    try {
+        t.fn();
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    t.group->finish(error);
+}
+
+// splits [0, count) into ranges of at most chunk_size and runs fn(begin, end) for each
+template<typename fn_t>
+inline void parallel_for_chunks(task_group &group, size_t count, size_t chunk_size, fn_t fn) {
+
+    chunk_size = std::max<size_t>(chunk_size, 1);
+
+    for (size_t begin = 0; begin < count; begin += chunk_size) {
+        const size_t end = std::min(count, begin + chunk_size);
+        group.run([fn, begin, end]() { fn(begin, end); });
+    }
+}
@@ -0,0 +1,124 @@
+#include "tracer.hpp"
+
+#include "json_writer.hpp"
+
+#include <algorithm>
+
+// a thread's buffer, known to the tracer for as long as the thread runs
+// whatever it recorded is kept once the thread exits
+struct registered_spans {
+    registered_spans() : spans(std::make_unique<tracer::thread_spans>()) {
+        auto &instance = tracer::get();
+        std::unique_lock<decltype(instance.buffers_mutex)> lock(instance.buffers_mutex);
+        spans->thread_id = instance.next_thread_id++;
+        instance.live_buffers.push_back(spans.get());
+    }
+
+    ~registered_spans() {
+        auto &instance = tracer::get();
+        std::unique_lock<decltype(instance.buffers_mutex)> lock(instance.buffers_mutex);
+        instance.live_buffers.erase(std::find(instance.live_buffers.begin(), instance.live_buffers.end(), spans.get()));
+        if (!spans->spans.empty()) {
+            instance.retired.push_back(std::move(spans));
+        }
+    }
+
+    std::unique_ptr<tracer::thread_spans> spans{};
+};
+
+tracer::thread_spans &tracer::local() {
+    thread_local registered_spans registered{};
+    return *registered.spans;
+}
+
+void tracer::enable() {
+    start = std::chrono::steady_clock::now();
+    enabled.store(true);
+}
+
+void tracer::name_thread(std::string_view name) {
+    auto &spans = local();
+    std::unique_lock<decltype(spans.mutex)> lock(spans.mutex);
+    spans.thread_name = name;
+}
+
+void tracer::record(const span &recorded) {
+    auto &spans = local();
+    std::unique_lock<decltype(spans.mutex)> lock(spans.mutex);
+    spans.spans.push_back(recorded);
+}
+
+// nanoseconds as microseconds with 3 decimals, the unit trace_event timestamps are in
+static void write_us(json_writer &writer, std::string_view name, uint64_t ns) {
+    writer.key(name);
+    writer.decimal(ns, 3);
+}
+
+void tracer::write_json(std::ostream &os) const {
+
+    std::unique_lock<decltype(buffers_mutex)> lock(buffers_mutex);
+
+    std::vector<thread_spans *> buffers(live_buffers.begin(), live_buffers.end());
+    for (const auto &spans : retired) {
+        buffers.push_back(spans.get());
+    }
+
+    std::sort(buffers.begin(), buffers.end(), [](const thread_spans *left, const thread_spans *right) {
+        return left->thread_id < right->thread_id;
+    });
+
+    json_writer writer(os);
+    writer.begin_object();
+
+    writer.field("displayTimeUnit", "ms");
+
+    writer.key("traceEvents");
+    writer.begin_array();
+
+    writer.begin_object();
+    writer.key("args");
+    writer.begin_object();
+    writer.field("name", "RPGMakerScraper");
+    writer.end_object();
+    writer.field("name", "process_name");
+    writer.field("ph", "M");
+    writer.field("pid", 1);
+    writer.end_object();
+
+    for (auto *spans : buffers) {
+        std::unique_lock<decltype(spans->mutex)> spans_lock(spans->mutex);
+
+        writer.begin_object();
+        writer.key("args");
+        writer.begin_object();
+        writer.field("name", spans->thread_name.empty() ? utils::format(format_literal("thread %d"), spans->thread_id) : spans->thread_name);
+        writer.end_object();
+        writer.field("name", "thread_name");
+        writer.field("ph", "M");
+        writer.field("pid", 1);
+        writer.field("tid", spans->thread_id);
+        writer.end_object();
+
+        for (const auto &[name, id, begin_ns, end_ns] : spans->spans) {
+            writer.begin_object();
+            if (id != no_id) {
+                writer.key("args");
+                writer.begin_object();
+                writer.field("id", id);
+                writer.end_object();
+            }
+            writer.field("cat", "scrape");
+            write_us(writer, "dur", end_ns - begin_ns);
+            writer.field("name", name);
+            writer.field("ph", "X");
+            writer.field("pid", 1);
+            writer.field("tid", spans->thread_id);
+            write_us(writer, "ts", begin_ns);
+            writer.end_object();
+        }
+    }
+
+    writer.end_array();
+    writer.end_object();
+    writer.newline();
+}
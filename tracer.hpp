@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "utils.hpp"
+
+// Records the begin and end of every span of work a run goes through, written
+// with --trace as Chrome trace_event json that opens in Perfetto or chrome://tracing.
+// Every thread records into its own buffer, the buffers are only gathered when
+// the trace is written. Nothing is recorded until enable() was called.
+class tracer {
+public:
+    // the id of a span that isn't about a single map or file
+    static constexpr int64_t no_id = -1;
+
+    // a single span of work on a single thread
+    struct span {
+        // always a string literal or one of the phase names, never owned
+        std::string_view name{};
+        int64_t id = no_id;
+        uint64_t begin_ns = 0;
+        uint64_t end_ns = 0;
+    };
+
+    // the spans of a single thread
+    struct thread_spans {
+        uint32_t thread_id = 0;
+        std::string thread_name{};
+        std::vector<span> spans{};
+        // only contended while the trace is written
+        std::mutex mutex{};
+    };
+
+    // records the scope it lives in as a span, if tracing is enabled
+    class scoped_span {
+    public:
+        explicit scoped_span(std::string_view _name, int64_t _id = no_id) : name(_name), id(_id), traced(get().is_enabled()) {
+            if (traced) {
+                begin_ns = get().now_ns();
+            }
+        }
+
+        ~scoped_span() {
+            if (traced) {
+                get().record({name, id, begin_ns, get().now_ns()});
+            }
+        }
+
+        scoped_span(const scoped_span &) = delete;
+        scoped_span &operator=(const scoped_span &) = delete;
+
+    private:
+        std::string_view name{};
+        int64_t id = no_id;
+        bool traced = false;
+        uint64_t begin_ns = 0;
+    };
+
+    // never destroyed, threads may still hand in their spans while the program exits
+    static tracer &get() {
+        static tracer *instance = new tracer();
+        return *instance;
+    }
+
+    // start recording, every timestamp is relative to this
+    void enable();
+
+    __forceinline bool is_enabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
+    // name the calling thread in the trace, threads without a name show up as 'thread <id>'
+    void name_thread(std::string_view name);
+
+    // write every span recorded so far as a trace_event json object
+    void write_json(std::ostream &os) const;
+
+private:
+    friend struct registered_spans;
+
+    tracer() = default;
+
+    // nanoseconds since enable()
+    __forceinline uint64_t now_ns() const {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    // the buffer of the calling thread
+    static thread_spans &local();
+
+    void record(const span &recorded);
+
+    std::atomic<bool> enabled{false};
+
+    std::chrono::steady_clock::time_point start{};
+
+    // the buffers of threads that are still running and of the ones that exited
+    mutable std::mutex buffers_mutex;
+    std::vector<thread_spans *> live_buffers{};
+    std::vector<std::unique_ptr<thread_spans>> retired{};
+    uint32_t next_thread_id = 1;
+};
@@ -1,18 +1,391 @@
 #pragma once
 
-#include <memory>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <wchar.h>
 
+// MSVC's forced inlining, spelled the way every other compiler understands
+#if !defined(_MSC_VER) && !defined(__forceinline)
+#define __forceinline inline __attribute__((always_inline))
+#endif
+
 namespace utils {
 
-    template<typename ... arg>
-    static std::string format_string(std::string_view fmt, arg ... args) {
-        const int size = std::snprintf(nullptr, NULL, fmt.data(), args ...) + 1;
-        const auto buf = std::make_unique<char[]>(size);
-        std::snprintf(buf.get(), size, fmt.data(), args ...);
+    // Text storage that keeps up to inline_capacity characters inside itself
+    // and only moves to the heap once something longer is appended.
+    template<size_t inline_capacity>
+    class small_string {
+    public:
+        // leaves the inline storage uninitialized, it's only read up to length
+        small_string() {}
+
+        small_string(const small_string &other) {
+            append(other.view());
+        }
+
+        small_string(small_string &&other) noexcept {
+            take(std::move(other));
+        }
+
+        small_string &operator=(const small_string &other) {
+            if (this != &other) {
+                clear();
+                append(other.view());
+            }
+            return *this;
+        }
+
+        small_string &operator=(small_string &&other) noexcept {
+            if (this != &other) {
+                clear();
+                take(std::move(other));
+            }
+            return *this;
+        }
+
+        void append(const char *text, size_t text_length) {
+
+            if (!spilled && length + text_length <= inline_capacity) {
+                std::memcpy(inline_text + length, text, text_length);
+                length += text_length;
+                return;
+            }
+
+            if (!spilled) {
+                heap_text.reserve(length + text_length);
+                heap_text.assign(inline_text, length);
+                spilled = true;
+            }
+
+            heap_text.append(text, text_length);
+        }
+
+        void append(std::string_view text) {
+            append(text.data(), text.size());
+        }
+
+        void push_back(char c) {
+            append(&c, 1);
+        }
+
+        void clear() {
+            length = 0;
+            spilled = false;
+            heap_text.clear();
+        }
+
+        __forceinline std::string_view view() const {
+            return spilled ? std::string_view(heap_text) : std::string_view(inline_text, length);
+        }
+
+        __forceinline size_t size() const {
+            return spilled ? heap_text.size() : length;
+        }
+
+        __forceinline bool empty() const {
+            return size() == 0;
+        }
+
+    private:
+
+        void take(small_string &&other) {
+            if (other.spilled) {
+                heap_text = std::move(other.heap_text);
+                spilled = true;
+            } else {
+                append(other.view());
+            }
+            other.clear();
+        }
+
+        size_t length = 0;
+        bool spilled = false;
+        char inline_text[inline_capacity];
+        std::string heap_text{};
+    };
+
+    // width, fill and base taken from a printf style conversion like %03d or %x
+    struct format_spec {
+        char fill = ' ';
+        uint32_t width = 0;
+        int base = 10;
+        // %X, hex digits in upper case
+        bool uppercase = false;
+    };
+
+    namespace detail {
+
+        template<typename>
+        inline constexpr bool unsupported_argument = false;
+
+        template<typename sink_t>
+        void write_padded(sink_t &sink, std::string_view text, const format_spec &spec) {
+            for (size_t i = text.size(); i < spec.width; ++i) {
+                sink.append(&spec.fill, 1);
+            }
+            sink.append(text.data(), text.size());
+        }
+
+        // every argument is written according to its own type, the conversion
+        // character only picks the base, check_format makes sure the two agree
+        template<typename sink_t, typename T>
+        void write_argument(sink_t &sink, const T &value, const format_spec &spec) {
+
+            if constexpr (std::is_same_v<T, bool>) {
+                write_padded(sink, value ? "true" : "false", spec);
+            } else if constexpr (std::is_same_v<T, char>) {
+                write_padded(sink, std::string_view(&value, 1), spec);
+            } else if constexpr (std::is_enum_v<T>) {
+                write_argument(sink, static_cast<std::underlying_type_t<T>>(value), spec);
+            } else if constexpr (std::is_integral_v<T>) {
+                char digits[72];
+                const auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), value, spec.base);
+                if (spec.uppercase) {
+                    for (char *digit = digits; digit != end; ++digit) {
+                        if (*digit >= 'a' && *digit <= 'z') {
+                            *digit = static_cast<char>(*digit - 'a' + 'A');
+                        }
+                    }
+                }
+                write_padded(sink, std::string_view(digits, end - digits), spec);
+            } else if constexpr (std::is_floating_point_v<T>) {
+                char digits[64];
+                const auto [end, error] = std::to_chars(std::begin(digits), std::end(digits), value);
+                write_padded(sink, std::string_view(digits, end - digits), spec);
+            } else if constexpr (std::is_pointer_v<T> && std::is_convertible_v<T, const char *>) {
+                write_padded(sink, value ? std::string_view(value) : std::string_view("(null)"), spec);
+            } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+                write_padded(sink, std::string_view(value), spec);
+            } else {
+                static_assert(unsupported_argument<T>, "this type can't be formatted");
+            }
+        }
+
+        template<typename sink_t, typename T>
+        void write_erased_argument(sink_t &sink, const void *value, const format_spec &spec) {
+            write_argument(sink, *static_cast<const T *>(value), spec);
+        }
+
+        // a single conversion inside a format, [begin, end) is all of it
+        struct conversion {
+            size_t begin = 0;
+            size_t end = 0;
+            format_spec spec{};
+            char letter = 0;
+        };
+
+        // find the first conversion of fmt at or after position
+        // %% and a % at the very end aren't conversions, they stay part of the text around them
+        constexpr bool next_conversion(std::string_view fmt, size_t position, conversion &found) {
+
+            while (position < fmt.size()) {
+
+                const size_t percent = fmt.find('%', position);
+                if (percent == std::string_view::npos) {
+                    return false;
+                }
 
-        return std::string(buf.get(), (buf.get() + size) - 1);
+                size_t cursor = percent + 1;
+                if (cursor < fmt.size() && fmt[cursor] == '%') {
+                    position = cursor + 1;
+                    continue;
+                }
+
+                format_spec spec{};
+                if (cursor < fmt.size() && fmt[cursor] == '0') {
+                    spec.fill = '0';
+                    ++cursor;
+                }
+                while (cursor < fmt.size() && fmt[cursor] >= '0' && fmt[cursor] <= '9') {
+                    spec.width = spec.width * 10 + (fmt[cursor] - '0');
+                    ++cursor;
+                }
+                // length modifiers mean nothing when the types are known
+                while (cursor < fmt.size() && (fmt[cursor] == 'l' || fmt[cursor] == 'h' || fmt[cursor] == 'z')) {
+                    ++cursor;
+                }
+
+                if (cursor >= fmt.size()) {
+                    return false;
+                }
+
+                const char letter = fmt[cursor];
+                if (letter == 'x' || letter == 'X') {
+                    spec.base = 16;
+                    spec.uppercase = letter == 'X';
+                }
+
+                found = {percent, cursor + 1, spec, letter};
+                return true;
+            }
+
+            return false;
+        }
+
+        // text in between conversions, with every %% written as a single %
+        template<typename sink_t>
+        void append_text(sink_t &sink, std::string_view text) {
+
+            size_t position = 0;
+            for (size_t escaped = text.find("%%"); escaped != std::string_view::npos; escaped = text.find("%%", position)) {
+                sink.append(text.data() + position, escaped + 1 - position);
+                position = escaped + 2;
+            }
+            sink.append(text.data() + position, text.size() - position);
+        }
+
+        enum class argument_kind {
+            NONE,
+            BOOL,
+            CHARACTER,
+            INTEGER,
+            FLOATING,
+            TEXT,
+        };
+
+        // what write_argument writes T as
+        template<typename T>
+        constexpr argument_kind kind_of() {
+            if constexpr (std::is_same_v<T, bool>) {
+                return argument_kind::BOOL;
+            } else if constexpr (std::is_same_v<T, char>) {
+                return argument_kind::CHARACTER;
+            } else if constexpr (std::is_enum_v<T> || std::is_integral_v<T>) {
+                return argument_kind::INTEGER;
+            } else if constexpr (std::is_floating_point_v<T>) {
+                return argument_kind::FLOATING;
+            } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+                return argument_kind::TEXT;
+            } else {
+                return argument_kind::NONE;
+            }
+        }
+
+        // whether a conversion letter fits an argument of the given kind, unknown letters fit nothing
+        constexpr bool accepts(char letter, argument_kind kind) {
+            switch (letter) {
+                case 'd':
+                case 'i':
+                case 'u':
+                case 'x':
+                case 'X':
+                    return kind == argument_kind::INTEGER;
+                case 'c':
+                    return kind == argument_kind::CHARACTER;
+                case 'f':
+                case 'g':
+                    return kind == argument_kind::FLOATING;
+                case 's':
+                    return kind == argument_kind::TEXT || kind == argument_kind::BOOL;
+                default:
+                    return false;
+            }
+        }
+
+        constexpr size_t count_conversions(std::string_view fmt) {
+            size_t count = 0;
+            conversion found{};
+            for (size_t position = 0; next_conversion(fmt, position, found); position = found.end) {
+                ++count;
+            }
+            return count;
+        }
+
+        // whether every conversion of fmt fits the argument it's going to be replaced with
+        template<typename ... arg>
+        constexpr bool conversions_fit(std::string_view fmt) {
+            constexpr argument_kind kinds[sizeof...(arg) + 1] = {kind_of<arg>()..., argument_kind::NONE};
+
+            size_t index = 0;
+            conversion found{};
+            for (size_t position = 0; next_conversion(fmt, position, found); position = found.end) {
+                if (index >= sizeof...(arg) || !accepts(found.letter, kinds[index++])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // format_to without checking fmt, every caller checks it with check_format first
+        template<typename sink_t, typename ... arg>
+        void format_unchecked(sink_t &sink, std::string_view fmt, const arg &... args) {
+
+            using write_fn = void (*)(sink_t &, const void *, const format_spec &);
+
+            struct erased_argument {
+                const void *value;
+                write_fn write;
+            };
+
+            // one extra entry so this is never a zero sized array
+            const erased_argument arguments[sizeof...(arg) + 1] = {
+                {static_cast<const void *>(&args), &write_erased_argument<sink_t, arg>}...,
+                {nullptr, nullptr},
+            };
+
+            size_t next_argument = 0;
+            size_t position = 0;
+            conversion found{};
+
+            while (next_conversion(fmt, position, found) && next_argument < sizeof...(arg)) {
+                append_text(sink, fmt.substr(position, found.begin - position));
+
+                const auto &argument = arguments[next_argument++];
+                argument.write(sink, argument.value, found.spec);
+
+                position = found.end;
+            }
+
+            append_text(sink, fmt.substr(position));
+        }
+    };
+
+    // the base of every format format_literal makes, its text is known when compiling
+    struct format_string {};
+
+    // the text of a format made with format_literal, after checking it against the arguments when compiling
+    // a conversion without an argument, an argument without a conversion or a conversion
+    // that doesn't fit the type of its argument (%d for text, %s for a number, ...) doesn't compile
+    template<typename ... arg, typename format_t>
+    constexpr std::string_view check_format(format_t) {
+        static_assert(std::is_base_of_v<format_string, format_t>, "formats have to be made with format_literal");
+        static_assert(detail::count_conversions(format_t::view()) == sizeof...(arg), "the format needs exactly one conversion per argument");
+        static_assert(detail::conversions_fit<std::decay_t<arg>...>(format_t::view()), "a conversion of the format doesn't fit the type of its argument");
+        return format_t::view();
+    }
+
+    // Write fmt into sink, replacing every printf style conversion (%d, %03d, %s, %x, ...)
+    // with the next argument. The arguments keep their types all the way through,
+    // so nothing is passed as varargs and nothing is allocated unless the sink grows.
+    // A sink is anything with append(const char *, size_t), e.g. std::string or small_string.
+    // fmt is made with format_literal, so it's checked against the arguments when compiling.
+    template<typename sink_t, typename format_t, typename ... arg>
+    void format_to(sink_t &sink, format_t fmt, const arg &... args) {
+        detail::format_unchecked(sink, check_format<arg...>(fmt), args...);
+    }
+
+    // format into a new string, for when the result has to outlive the call
+    template<typename format_t, typename ... arg>
+    std::string format(format_t fmt, const arg &... args) {
+        std::string result{};
+        format_to(result, fmt, args...);
+        return result;
     }
 };
+
+// a format for utils::format_to and everything built on it, e.g. format_literal("Map%03d.json")
+// every literal becomes a type of its own, which lets its text be checked when compiling
+#define format_literal(literal_text) \
+    ([]() { \
+        struct literal : utils::format_string { \
+            static constexpr std::string_view view() { \
+                return literal_text; \
+            } \
+        }; \
+        return literal{}; \
+    }())